@@ -0,0 +1,384 @@
+//Headless tournament runner: plays the AI engines against each other, without the GUI.
+//Every pair of engines plays the given number of games in every grid configuration, each engine
+//moving first in half of them. Games are played in parallel, one per worker thread.
+//Reports the results of every pairing, and per engine: win/draw/loss rates, Elo rating and moves per second,
+//plus the average depth reached by the minmax engine.
+/*
+	Portable, only depends on the game engine headers. Build with:
+		g++ -O2 -std=c++11 -pthread Arena.cpp -o arena
+	or the Arena project in the solution.
+
+	Usage: arena [options]
+		-engines LIST   Comma separated engines to play: random,heuristic,minmax,mcts (default: all).
+		-sizes A-B      Range of grid sizes (default: 3-6).
+		-towin A-B      Range of winning combination lengths, limited by the grid size (default: 3-6).
+		-games N        Games per pairing and configuration (default: 10).
+		-time N         Time per move of the minmax and MCTS engines, in microseconds (default: 20000).
+		-workers N      Number of games played at once (default: one per CPU core).
+		-seed N         Seed of the random and heuristic engines (default: 1).
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include "Game.h"
+#include "MCTS.h"
+
+enum Engine {
+	RandomEngine = 0,
+	HeuristicEngine,
+	MinmaxEngine,
+	MctsEngine,
+	NEngines
+};
+static const char* engineNames[NEngines] = {"random", "heuristic", "minmax", "mcts"};
+
+static const int HashTableSize = 16; //Transposition table of every worker, in megabytes.
+static const int MctsTreeSize = 32; //MCTS node arena of every worker, in megabytes.
+
+struct Settings
+{
+	std::vector<int> engines;
+	int minSize, maxSize;
+	int minToWin, maxToWin;
+	int games;
+	int moveTime;
+	int workers;
+	uint64_t seed;
+};
+
+//Results of one engine against another. Indexed by [engine][opponent].
+struct Score
+{
+	int wins;
+	int draws;
+	int losses;
+};
+
+//A single game to play.
+struct Match
+{
+	int size;
+	int nToWin;
+	int engine[3];//Engines playing as Player 1 and Player 2, engine[0] is unused.
+	uint64_t seed;
+};
+
+//Engine state owned by a worker thread and reused between its games.
+struct Worker
+{
+	Game game;
+	TranspositionTable transpositionTable;
+	MCTS mcts;
+	long long moves[NEngines];//Moves made by each engine.
+	double seconds[NEngines];//Time spent choosing them.
+	long long depths[NEngines];//Sum of the depths reached by the minmax searches.
+
+	Worker()
+	{
+		transpositionTable.allocate(HashTableSize);
+		mcts.allocate(MctsTreeSize);
+		memset(moves, 0, sizeof(moves));
+		memset(seconds, 0, sizeof(seconds));
+		memset(depths, 0, sizeof(depths));
+	}
+	int move(int engine, int player, int moveTime)
+	{
+		switch(engine){
+		case RandomEngine: return game.randomMove();
+		case HeuristicEngine: return game.heuristicMove(player);
+		case MinmaxEngine: return game.minmaxMove(player, moveTime);
+		default: return mcts.move(game, player, moveTime);
+		}
+	}
+	//Play the match and return the final game state.
+	int play(const Match& match, int moveTime)
+	{
+		game.tt = &transpositionTable;
+		game.reset(match.size, match.nToWin);//Also clears the transposition table.
+		game.seedRandom(match.seed);
+		mcts.clear();
+		int player = 1;
+		while(true){
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			const int engine = match.engine[player];
+			int cell = move(engine, player, moveTime);
+			seconds[engine] += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			++moves[engine];
+			if(engine == MinmaxEngine){
+				depths[engine] += game.stats.depth;
+			}
+			int state = game.applyMove(cell, player);
+			if(state != 0){
+				return state;
+			}
+			player = 3-player;
+		}
+	}
+};
+
+struct Tournament
+{
+	Settings settings;
+	std::vector<Match> matches;
+	std::atomic<int> nextMatch;
+	std::mutex resultsMutex;
+	Score scores[NEngines][NEngines];
+	long long moves[NEngines];
+	double seconds[NEngines];
+	long long depths[NEngines];
+	std::vector<Score> configScores;//Per configuration, for the first engine of each pairing in the order of matches.
+
+	Tournament()
+	{
+		nextMatch = 0;
+		memset(scores, 0, sizeof(scores));
+		memset(moves, 0, sizeof(moves));
+		memset(seconds, 0, sizeof(seconds));
+		memset(depths, 0, sizeof(depths));
+	}
+	void addResult(Score& score, int state, int player)
+	{
+		if(state == 3){
+			++score.draws;
+		}else if(state == player){
+			++score.wins;
+		}else{
+			++score.losses;
+		}
+	}
+	void workerRoutine()
+	{
+		Worker worker;
+		for(int m; (m = nextMatch++) < (int)matches.size(); ){
+			const Match& match = matches[m];
+			int state = worker.play(match, settings.moveTime);
+			std::lock_guard<std::mutex> lock(resultsMutex);
+			addResult(scores[match.engine[1]][match.engine[2]], state, 1);
+			addResult(scores[match.engine[2]][match.engine[1]], state, 2);
+			//Both colors of a pairing are reported together, from the view of the engine moving first in the first game.
+			const int c = m / (2*settings.games);
+			const int first = matches[c * 2*settings.games].engine[1];
+			addResult(configScores[c], state, (match.engine[1] == first) ? 1 : 2);
+		}
+		std::lock_guard<std::mutex> lock(resultsMutex);
+		for(int e=0; e<NEngines; e++){
+			moves[e] += worker.moves[e];
+			seconds[e] += worker.seconds[e];
+			depths[e] += worker.depths[e];
+		}
+	}
+	//Matches are grouped by configuration and pairing, each pairing once with either engine moving first.
+	void createMatches()
+	{
+		const int nEngines = (int)settings.engines.size();
+		int n = 0;
+		for(int size=settings.minSize; size<=settings.maxSize; size++){
+			for(int ntw=settings.minToWin; ntw<=settings.maxToWin && ntw<=size; ntw++){
+				for(int a=0; a<nEngines; a++){
+					for(int b=a+1; b<nEngines; b++){
+						for(int order=0; order<2; order++){
+							for(int g=0; g<settings.games; g++){
+								Match match;
+								match.size = size;
+								match.nToWin = ntw;
+								match.engine[0] = -1;
+								match.engine[1] = settings.engines[order ? b : a];
+								match.engine[2] = settings.engines[order ? a : b];
+								match.seed = settings.seed + n++;
+								matches.push_back(match);
+							}
+						}
+					}
+				}
+			}
+		}
+		Score zero = {0, 0, 0};
+		configScores.assign(matches.size() / (2*settings.games), zero);
+	}
+	void run()
+	{
+		createMatches();
+		std::vector<std::thread> threads;
+		for(int t=0; t<settings.workers; t++){
+			threads.push_back(std::thread(&Tournament::workerRoutine, this));
+		}
+		for(size_t t=0; t<threads.size(); t++){
+			threads[t].join();
+		}
+	}
+
+	//Ratings fitted to all the results with the Bradley-Terry model, a draw counting as half a win.
+	//Every pair is also given one virtual draw, so that engines which never lose or never win get finite ratings.
+	//The ratings are relative, their average is 0.
+	void computeElo(double* elo)
+	{
+		const std::vector<int>& engines = settings.engines;
+		const int n = (int)engines.size();
+		std::vector<double> strength(n, 1.);
+		for(int iteration=0; iteration<1000; iteration++){
+			for(int a=0; a<n; a++){
+				double won = 0;
+				double sum = 0;
+				for(int b=0; b<n; b++){
+					if(a == b) continue;
+					const Score& s = scores[engines[a]][engines[b]];
+					won += s.wins + .5 * s.draws + .5;
+					sum += (s.wins + s.draws + s.losses + 1) / (strength[a] + strength[b]);
+				}
+				strength[a] = won / sum;
+			}
+		}
+		double average = 0;
+		for(int a=0; a<n; a++){
+			elo[a] = 400. * log10(strength[a]);
+			average += elo[a] / n;
+		}
+		for(int a=0; a<n; a++){
+			elo[a] -= average;
+		}
+	}
+	void report()
+	{
+		const std::vector<int>& engines = settings.engines;
+		const int n = (int)engines.size();
+		printf("Pairings (wins-draws-losses of the first engine):\n");
+		for(size_t c=0; c<configScores.size(); c++){
+			const Match& match = matches[c * 2*settings.games];
+			const Score& s = configScores[c];
+			printf("  %dx%dx%d, %d to win: %-9s vs %-9s %4d-%d-%d\n", match.size, match.size, match.size, match.nToWin,
+				engineNames[match.engine[1]], engineNames[match.engine[2]], s.wins, s.draws, s.losses);
+		}
+
+		double elo[NEngines];
+		computeElo(elo);
+		printf("\n%-9s %7s %7s %7s %7s %7s %12s %7s\n", "Engine", "Games", "Win%", "Draw%", "Loss%", "Elo", "Moves/sec", "Depth");
+		for(int a=0; a<n; a++){
+			const int e = engines[a];
+			Score total = {0, 0, 0};
+			for(int b=0; b<NEngines; b++){
+				total.wins += scores[e][b].wins;
+				total.draws += scores[e][b].draws;
+				total.losses += scores[e][b].losses;
+			}
+			int games = total.wins + total.draws + total.losses;
+			double pct = games ? 100. / games : 0;
+			printf("%-9s %7d %7.1f %7.1f %7.1f %7.0f %12.0f", engineNames[e], games,
+				total.wins * pct, total.draws * pct, total.losses * pct, elo[a], seconds[e] > 0 ? moves[e] / seconds[e] : 0.);
+			if(e == MinmaxEngine && moves[e] > 0){
+				printf(" %7.1f\n", (double)depths[e] / moves[e]);
+			}else{
+				printf(" %7s\n", "-");
+			}
+		}
+	}
+};
+
+//Parse "N" or "N-M".
+static bool parseRange(const char* text, int& from, int& to)
+{
+	char* end;
+	from = (int)strtol(text, &end, 10);
+	if(end == text){
+		return false;
+	}
+	to = from;
+	if(*end == '-'){
+		const char* second = end+1;
+		to = (int)strtol(second, &end, 10);
+		if(end == second){
+			return false;
+		}
+	}
+	return *end == 0;
+}
+
+static bool parseEngines(const char* text, std::vector<int>& engines)
+{
+	engines.clear();
+	std::string list(text);
+	size_t start = 0;
+	while(start <= list.size()){
+		size_t end = list.find(',', start);
+		if(end == std::string::npos){
+			end = list.size();
+		}
+		std::string name = list.substr(start, end - start);
+		int e = 0;
+		while(e < NEngines && name != engineNames[e]){
+			++e;
+		}
+		if(e == NEngines){
+			fprintf(stderr, "Unknown engine: %s\n", name.c_str());
+			return false;
+		}
+		engines.push_back(e);
+		start = end + 1;
+	}
+	return engines.size() >= 2;
+}
+
+int main(int argc, char** argv)
+{
+	Tournament tournament;
+	Settings& s = tournament.settings;
+	for(int e=0; e<NEngines; e++){
+		s.engines.push_back(e);
+	}
+	s.minSize = 3;
+	s.maxSize = 6;
+	s.minToWin = 3;
+	s.maxToWin = 6;
+	s.games = 10;
+	s.moveTime = 20000;
+	s.workers = std::thread::hardware_concurrency();
+	s.seed = 1;
+
+	bool ok = true;
+	for(int a=1; a<argc && ok; a++){
+		const char* value = (a+1 < argc) ? argv[a+1] : 0;
+		if(! value){
+			ok = false;
+		}else if(! strcmp(argv[a], "-engines")){
+			ok = parseEngines(value, s.engines);
+		}else if(! strcmp(argv[a], "-sizes")){
+			ok = parseRange(value, s.minSize, s.maxSize) && s.minSize >= 3 && s.maxSize <= 6;
+		}else if(! strcmp(argv[a], "-towin")){
+			ok = parseRange(value, s.minToWin, s.maxToWin) && s.minToWin >= 3 && s.maxToWin <= 6;
+		}else if(! strcmp(argv[a], "-games")){
+			s.games = atoi(value);
+			ok = (s.games > 0);
+		}else if(! strcmp(argv[a], "-time")){
+			s.moveTime = atoi(value);
+			ok = (s.moveTime > 0);
+		}else if(! strcmp(argv[a], "-workers")){
+			s.workers = atoi(value);
+			ok = (s.workers > 0);
+		}else if(! strcmp(argv[a], "-seed")){
+			s.seed = strtoull(value, 0, 10);
+		}else{
+			ok = false;
+		}
+		++a;
+	}
+	if(! ok){
+		fprintf(stderr, "Usage: %s [-engines random,heuristic,minmax,mcts] [-sizes 3-6] [-towin 3-6] [-games N] [-time us] [-workers N] [-seed N]\n", argv[0]);
+		return 1;
+	}
+	if(s.workers < 1){
+		s.workers = 1;
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	tournament.run();
+	tournament.report();
+	printf("\n%d games in %.1f s\n", (int)tournament.matches.size(),
+		std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+	return 0;
+}
@@ -1,41 +1,100 @@
 #pragma once
 
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <new>
+
 //A convenient representation for a three-dimensional array [size x size x size].
+//Elements are plain values (numbers), they are copied as raw memory and not constructed.
+//The buffer is aligned to a cache line. Arrays of up to InlineCapacity elements are stored
+//inside the object itself instead of the heap, so that they cost no allocation to create or copy.
 
-template<typename T>
+template<typename T, int InlineCapacity = 0>
 struct Array3
 {
+	static const int CacheLine = 64;
 	int size;
-	T* buffer;
+	T* buffer;//Points to the aligned heap block or to local.
+	void* memory;//The heap block, 0 if the elements are stored inline.
+	T local[InlineCapacity > 0 ? InlineCapacity : 1];
+
 	Array3()
 	{
 		size = 0;
-		buffer = 0;
+		buffer = local;
+		memory = 0;
 	}
 	Array3(int sz)
 	{
 		size = 0;
-		buffer = 0;
+		buffer = local;
+		memory = 0;
 		allocate(sz);
 	}
+	Array3(const Array3& other)
+	{
+		size = 0;
+		buffer = local;
+		memory = 0;
+		*this = other;
+	}
+	Array3(Array3&& other) throw()
+	{
+		size = 0;
+		buffer = local;
+		memory = 0;
+		*this = static_cast<Array3&&>(other);
+	}
 	~Array3()
 	{
-		if(buffer){
-			delete[] buffer;
+		::operator delete(memory);
+	}
+	Array3& operator= (const Array3& other)
+	{
+		if(this != &other){
+			allocate(other.size);
+			memcpy(buffer, other.buffer, bufferSize() * sizeof(T));
+		}
+		return *this;
+	}
+	//Heap blocks are taken over, inline elements are copied.
+	Array3& operator= (Array3&& other) throw()
+	{
+		if(this != &other){
+			if(other.memory){
+				::operator delete(memory);
+				size = other.size;
+				buffer = other.buffer;
+				memory = other.memory;
+				other.size = 0;
+				other.buffer = other.local;
+				other.memory = 0;
+			}else{
+				*this = static_cast<const Array3&>(other);
+			}
 		}
+		return *this;
 	}
-	int bufferSize()
+	int bufferSize() const
 	{
 		return size*size*size;
 	}
+	//Resize the array. The contents are undefined afterwards.
 	void allocate(int sz)
 	{
 		if(sz != size){
-			if(buffer){
-				delete[] buffer;
+			::operator delete(memory);
+			memory = 0;
+			size = 0;
+			buffer = local;
+			if(sz*sz*sz > InlineCapacity){
+				//Allocated through operator new, like the rest of the program's memory, so that it's counted
+				//by the Benchmark's allocation check. It throws std::bad_alloc rather than return 0.
+				memory = ::operator new(sz*sz*sz * sizeof(T) + CacheLine-1);
+				buffer = (T*)(((uintptr_t)memory + CacheLine-1) & ~(uintptr_t)(CacheLine-1));
 			}
 			size = sz;
-			buffer = new T[size*size*size];
 		}
 	}
 	int index(int i, int j, int k)
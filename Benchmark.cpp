@@ -0,0 +1,317 @@
+//Microbenchmarks of the game engine's hot paths.
+//Every routine is run on a set of seeded random positions for every grid configuration offered by the menu.
+//Reports time per operation, operations per second and heap allocations per operation.
+/*
+	Portable, only depends on the game engine headers. Build with:
+		g++ -O2 -std=c++11 -pthread Benchmark.cpp -o benchmark
+	or the Benchmark project in the solution.
+
+	Usage: benchmark [options]
+		-json FILE      Also write the results to a JSON file, to compare builds.
+		-sizes A-B      Range of grid sizes (default: 3-6).
+		-time N         Minimum time to run each benchmark, in milliseconds (default: 100).
+		-positions N    Number of random positions per configuration (default: 16).
+		-seed N         Seed of the random positions (default: 1).
+		-checkallocs    Fail if any routine allocates memory, once its buffers are set up.
+
+	Operations measured:
+		checkGameState      One call, evaluating the whole grid.
+		isLinePotentialWin  One call, for a single line.
+		applyMove/undoMove  Making and taking back one move.
+		randomMove          One call.
+		heuristicMove       One call.
+		minmax              One node of a 1 ms iterative deepening search, so ops/s are nodes per second.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+#include <vector>
+#include <string>
+#include <atomic>
+#include <chrono>
+#include "Game.h"
+
+//Heap allocations are counted by replacing the global allocation operators.
+static std::atomic<long long> allocations(0);
+
+void* operator new(size_t n)
+{
+	++allocations;
+	void* p = malloc(n ? n : 1);
+	if(! p){
+		throw std::bad_alloc();
+	}
+	return p;
+}
+void* operator new[](size_t n)
+{
+	return operator new(n);
+}
+void operator delete(void* p) throw()
+{
+	free(p);
+}
+void operator delete[](void* p) throw()
+{
+	free(p);
+}
+
+static const int HashTableSize = 16; //Transposition table of the minmax benchmark, in megabytes.
+static const int MinmaxMoveTime = 1000; //Time of every minmax search, in microseconds.
+
+struct Result
+{
+	std::string name;
+	int size;
+	int nToWin;
+	long long ops;
+	double seconds;
+	long long allocations;
+};
+
+struct Benchmark
+{
+	int minSize, maxSize;
+	int minTime;//In milliseconds.
+	int nPositions;
+	uint64_t seed;
+	std::vector<Result> results;
+	volatile int sink;//Results of the measured calls go here, so that they aren't optimized away.
+	bool checkAllocations;
+	int nAllocatingBenchmarks;
+
+	int size;//Configuration being measured.
+	int nToWin;
+	std::vector<Game*> positions;
+	TranspositionTable transpositionTable;
+
+	Benchmark()
+	{
+		minSize = 3;
+		maxSize = 6;
+		minTime = 100;
+		nPositions = 16;
+		seed = 1;
+		sink = 0;
+		checkAllocations = false;
+		nAllocatingBenchmarks = 0;
+		size = 0;
+		nToWin = 0;
+	}
+	~Benchmark()
+	{
+		clearPositions();
+	}
+	void clearPositions()
+	{
+		for(size_t p=0; p<positions.size(); p++){
+			delete positions[p];
+		}
+		positions.clear();
+	}
+	//Play a random number of random moves on each position, short of finishing the game.
+	void createPositions()
+	{
+		clearPositions();
+		for(int p=0; p<nPositions; p++){
+			Game* game = new Game();
+			game->reset(size, nToWin);
+			game->seedRandom(seed + p);
+			const int nCells = game->contents.bufferSize();
+			const int nMoves = game->randomInt(nCells/2 + 1);
+			for(int m=0; m<nMoves; m++){
+				int cell = game->randomMove();
+				if(game->applyMove(cell, 1 + m%2) != 0){
+					game->undoMove(cell);
+					break;
+				}
+			}
+			positions.push_back(game);
+		}
+	}
+	//The player to move in the position.
+	static int turn(Game* game)
+	{
+		return 1 + game->nMoves%2;
+	}
+
+	//Run the routine over all positions repeatedly, for at least the minimum time.
+	//The routine is called with a position and returns the number of operations it did.
+	//All the routines are meant to be allocation-free. With checkAllocations set, allocating is reported as an error.
+	template<typename Routine>
+	void run(const char* name, Routine routine)
+	{
+		Result r;
+		r.name = name;
+		r.size = size;
+		r.nToWin = nToWin;
+		r.ops = 0;
+		r.seconds = 0;
+		//Warm up, e.g. let the routines allocate their persistent buffers.
+		for(size_t p=0; p<positions.size(); p++){
+			routine(positions[p]);
+		}
+		long long allocationsBefore = allocations;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		while(r.seconds * 1000 < minTime){
+			for(size_t p=0; p<positions.size(); p++){
+				r.ops += routine(positions[p]);
+			}
+			r.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		}
+		r.allocations = allocations - allocationsBefore;
+		results.push_back(r);
+		printf("%-20s %dx%dx%d %d  %12.1f ns/op %14.0f ops/s %8.2f allocs/op\n", name, size, size, size, nToWin,
+			r.seconds * 1e9 / r.ops, r.ops / r.seconds, (double)r.allocations / r.ops);
+		if(checkAllocations && r.allocations > 0){
+			printf("Error: %s allocates memory\n", name);
+			++nAllocatingBenchmarks;
+		}
+		fflush(stdout);
+	}
+
+	void runConfiguration()
+	{
+		createPositions();
+		run("checkGameState", [this](Game* game){
+			sink += game->checkGameState();
+			return 1;
+		});
+		run("isLinePotentialWin", [this](Game* game){
+			int n = 0;
+			for(int l=0; l<game->nLines; l++){
+				n += game->isLinePotentialWin(l);
+			}
+			sink += n;
+			return game->nLines;
+		});
+		run("applyMove/undoMove", [this](Game* game){
+			int n = 0;
+			for(int i=0; i<game->contents.bufferSize(); i++){
+				if(game->contents[i] == 0){
+					sink += game->applyMove(i, turn(game));
+					game->undoMove(i);
+					++n;
+				}
+			}
+			return n;
+		});
+		run("randomMove", [this](Game* game){
+			sink += game->randomMove();
+			return 1;
+		});
+		run("heuristicMove", [this](Game* game){
+			sink += game->heuristicMove(turn(game));
+			return 1;
+		});
+		//Start every configuration with an empty table, so that entries left by the previous ones don't skew its numbers.
+		transpositionTable.clear();
+		run("minmax", [this](Game* game){
+			game->tt = &transpositionTable;
+			unsigned nodes = game->nodeCounter;
+			sink += game->minmaxMove(turn(game), MinmaxMoveTime);
+			game->tt = 0;
+			return (int)(game->nodeCounter - nodes);
+		});
+	}
+	void runAll()
+	{
+		transpositionTable.allocate(HashTableSize);
+		for(size = minSize; size <= maxSize; size++){
+			for(nToWin = 3; nToWin <= size; nToWin++){
+				runConfiguration();
+			}
+		}
+	}
+	bool writeJson(const char* path)
+	{
+#ifdef _MSC_VER
+		FILE* f = 0;
+		if(fopen_s(&f, path, "w") != 0){
+			return false;
+		}
+#else
+		FILE* f = fopen(path, "w");
+		if(! f){
+			return false;
+		}
+#endif
+		fprintf(f, "{\n\t\"seed\": %llu,\n\t\"positions\": %d,\n\t\"benchmarks\": [\n", (unsigned long long)seed, nPositions);
+		for(size_t i=0; i<results.size(); i++){
+			const Result& r = results[i];
+			fprintf(f, "\t\t{\"name\": \"%s\", \"size\": %d, \"nToWin\": %d, \"ops\": %lld, \"seconds\": %.6f, "
+				"\"ns_per_op\": %.3f, \"ops_per_sec\": %.1f, \"allocs_per_op\": %.4f}%s\n",
+				r.name.c_str(), r.size, r.nToWin, r.ops, r.seconds,
+				r.seconds * 1e9 / r.ops, r.ops / r.seconds, (double)r.allocations / r.ops,
+				(i+1 < results.size()) ? "," : "");
+		}
+		fprintf(f, "\t]\n}\n");
+		fclose(f);
+		return true;
+	}
+};
+
+//Parse "N" or "N-M".
+static bool parseRange(const char* text, int& from, int& to)
+{
+	char* end;
+	from = (int)strtol(text, &end, 10);
+	if(end == text){
+		return false;
+	}
+	to = from;
+	if(*end == '-'){
+		const char* second = end+1;
+		to = (int)strtol(second, &end, 10);
+		if(end == second){
+			return false;
+		}
+	}
+	return *end == 0;
+}
+
+int main(int argc, char** argv)
+{
+	Benchmark benchmark;
+	const char* jsonPath = 0;
+	bool ok = true;
+	for(int a=1; a<argc && ok; a++){
+		const char* value = (a+1 < argc) ? argv[a+1] : "";
+		if(! strcmp(argv[a], "-checkallocs")){
+			benchmark.checkAllocations = true;
+			continue;
+		}else if(a+1 >= argc){
+			ok = false;
+		}else if(! strcmp(argv[a], "-json")){
+			jsonPath = value;
+		}else if(! strcmp(argv[a], "-sizes")){
+			ok = parseRange(value, benchmark.minSize, benchmark.maxSize) && benchmark.minSize >= 3 && benchmark.maxSize <= 6;
+		}else if(! strcmp(argv[a], "-time")){
+			benchmark.minTime = atoi(value);
+			ok = (benchmark.minTime > 0);
+		}else if(! strcmp(argv[a], "-positions")){
+			benchmark.nPositions = atoi(value);
+			ok = (benchmark.nPositions > 0);
+		}else if(! strcmp(argv[a], "-seed")){
+			benchmark.seed = strtoull(value, 0, 10);
+		}else{
+			ok = false;
+		}
+		++a;
+	}
+	if(! ok){
+		fprintf(stderr, "Usage: %s [-json FILE] [-sizes 3-6] [-time ms] [-positions N] [-seed N] [-checkallocs]\n", argv[0]);
+		return 1;
+	}
+
+	benchmark.runAll();
+	if(jsonPath && ! benchmark.writeJson(jsonPath)){
+		fprintf(stderr, "Failed to write %s\n", jsonPath);
+		return 1;
+	}
+	if(benchmark.nAllocatingBenchmarks > 0){
+		return 1;
+	}
+	return 0;
+}
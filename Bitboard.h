@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdint.h>
+
+//A set of grid cells stored as one bit per cell.
+//256 bits are enough for the largest 6x6x6 grid (216 cells).
+struct Bitboard
+{
+	static const int NWords = 4;
+	uint64_t words[NWords];
+
+	void clear()
+	{
+		for(int w=0; w<NWords; w++){
+			words[w] = 0;
+		}
+	}
+	void set(int cell)
+	{
+		words[cell >> 6] |= (uint64_t)1 << (cell & 63);
+	}
+	void reset(int cell)
+	{
+		words[cell >> 6] &= ~((uint64_t)1 << (cell & 63));
+	}
+	//True if all the cells of the mask are in the set: (board & mask) == mask.
+	bool containsAll(const Bitboard& mask) const
+	{
+		return
+			((words[0] & mask.words[0]) == mask.words[0]) &
+			((words[1] & mask.words[1]) == mask.words[1]) &
+			((words[2] & mask.words[2]) == mask.words[2]) &
+			((words[3] & mask.words[3]) == mask.words[3]);
+	}
+	//True if at least one cell of the mask is in the set: (board & mask) != 0.
+	bool intersects(const Bitboard& mask) const
+	{
+		return (
+			(words[0] & mask.words[0]) |
+			(words[1] & mask.words[1]) |
+			(words[2] & mask.words[2]) |
+			(words[3] & mask.words[3])) != 0;
+	}
+};
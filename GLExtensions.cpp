@@ -0,0 +1,39 @@
+#include <Windows.h>
+#include <gl/GL.h>
+#include "GLExtensions.h"
+
+#define GL_EXTENSION_DEFINE(ret, name, params) \
+	name##Proc name = 0;
+GL_EXTENSION_FUNCTIONS(GL_EXTENSION_DEFINE)
+#undef GL_EXTENSION_DEFINE
+
+//Some drivers return small values other than 0 for missing functions.
+static void* getGLFunction(const char* name)
+{
+	void* f = (void*)wglGetProcAddress(name);
+	if((intptr_t)f >= -1 && (intptr_t)f <= 3){
+		return 0;
+	}
+	return f;
+}
+
+bool loadGLExtensions()
+{
+	bool ok = true;
+#define GL_EXTENSION_LOAD(ret, name, params) \
+	name = (name##Proc)getGLFunction(#name); \
+	if(! name){ \
+		name = (name##Proc)getGLFunction(#name "ARB"); \
+	} \
+	ok = ok && (name != 0);
+	GL_EXTENSION_FUNCTIONS(GL_EXTENSION_LOAD)
+#undef GL_EXTENSION_LOAD
+	return ok;
+}
+
+bool setSwapInterval(int interval)
+{
+	typedef BOOL (APIENTRY* wglSwapIntervalEXTProc)(int interval);
+	wglSwapIntervalEXTProc wglSwapIntervalEXT = (wglSwapIntervalEXTProc)getGLFunction("wglSwapIntervalEXT");
+	return wglSwapIntervalEXT != 0 && wglSwapIntervalEXT(interval) != FALSE;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+/*
+	OpenGL functions beyond version 1.1, which is all that the Windows SDK's gl/GL.h declares.
+	They are loaded at run time with wglGetProcAddress, after a rendering context has been made current.
+	Needed for vertex buffers, shaders and instanced drawing.
+	The function pointers are defined in GLExtensions.cpp.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef char GLchar;
+typedef ptrdiff_t GLsizeiptr;
+typedef ptrdiff_t GLintptr;
+
+#define GL_ARRAY_BUFFER         0x8892
+#define GL_ELEMENT_ARRAY_BUFFER 0x8893
+#define GL_STATIC_DRAW          0x88E4
+#define GL_DYNAMIC_DRAW         0x88E8
+#define GL_FRAGMENT_SHADER      0x8B30
+#define GL_VERTEX_SHADER        0x8B31
+#define GL_COMPILE_STATUS       0x8B81
+#define GL_LINK_STATUS          0x8B82
+
+//Return type, name and parameters of every function.
+#define GL_EXTENSION_FUNCTIONS(F) \
+	F(void,   glGenBuffers,              (GLsizei n, GLuint* buffers)) \
+	F(void,   glDeleteBuffers,           (GLsizei n, const GLuint* buffers)) \
+	F(void,   glBindBuffer,              (GLenum target, GLuint buffer)) \
+	F(void,   glBufferData,              (GLenum target, GLsizeiptr size, const void* data, GLenum usage)) \
+	F(void,   glBufferSubData,           (GLenum target, GLintptr offset, GLsizeiptr size, const void* data)) \
+	F(GLuint, glCreateShader,            (GLenum type)) \
+	F(void,   glDeleteShader,            (GLuint shader)) \
+	F(void,   glShaderSource,            (GLuint shader, GLsizei count, const GLchar* const* strings, const GLint* lengths)) \
+	F(void,   glCompileShader,           (GLuint shader)) \
+	F(void,   glGetShaderiv,             (GLuint shader, GLenum name, GLint* value)) \
+	F(void,   glGetShaderInfoLog,        (GLuint shader, GLsizei size, GLsizei* length, GLchar* log)) \
+	F(GLuint, glCreateProgram,           ()) \
+	F(void,   glAttachShader,            (GLuint program, GLuint shader)) \
+	F(void,   glBindAttribLocation,      (GLuint program, GLuint index, const GLchar* name)) \
+	F(void,   glLinkProgram,             (GLuint program)) \
+	F(void,   glGetProgramiv,            (GLuint program, GLenum name, GLint* value)) \
+	F(void,   glGetProgramInfoLog,       (GLuint program, GLsizei size, GLsizei* length, GLchar* log)) \
+	F(void,   glUseProgram,              (GLuint program)) \
+	F(GLint,  glGetUniformLocation,      (GLuint program, const GLchar* name)) \
+	F(void,   glUniform1f,               (GLint location, GLfloat v0)) \
+	F(void,   glUniform3fv,              (GLint location, GLsizei count, const GLfloat* value)) \
+	F(void,   glUniform4fv,              (GLint location, GLsizei count, const GLfloat* value)) \
+	F(void,   glEnableVertexAttribArray,  (GLuint index)) \
+	F(void,   glDisableVertexAttribArray, (GLuint index)) \
+	F(void,   glVertexAttribPointer,     (GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void* pointer)) \
+	F(void,   glVertexAttrib2f,          (GLuint index, GLfloat x, GLfloat y)) \
+	F(void,   glVertexAttrib4f,          (GLuint index, GLfloat x, GLfloat y, GLfloat z, GLfloat w)) \
+	F(void,   glVertexAttrib4fv,         (GLuint index, const GLfloat* value)) \
+	F(void,   glVertexAttribDivisor,     (GLuint index, GLuint divisor)) \
+	F(void,   glMultiDrawArrays,         (GLenum mode, const GLint* first, const GLsizei* count, GLsizei drawCount)) \
+	F(void,   glDrawArraysInstanced,     (GLenum mode, GLint first, GLsizei count, GLsizei instances))
+
+#define GL_EXTENSION_DECLARE(ret, name, params) \
+	typedef ret (APIENTRY* name##Proc) params; \
+	extern name##Proc name;
+GL_EXTENSION_FUNCTIONS(GL_EXTENSION_DECLARE)
+#undef GL_EXTENSION_DECLARE
+
+//Load the functions. Instancing is core since OpenGL 3.1/3.3 and is tried under its ARB extension names
+//for older drivers. Returns false if any is missing, e.g. with the generic GDI renderer.
+bool loadGLExtensions();
+
+//Synchronize buffer swaps with the display's refresh: wait for this many refreshes per swap, 0 not to wait.
+//Returns false if the driver doesn't support it.
+bool setSwapInterval(int interval);
@@ -7,6 +7,7 @@
 	where the bitmap's pixels are copied to present the GUI on screen with transparency.
 
 	A collection of 'widgets' representing labels and buttons is maintained and rendered into the bitmap.
+	Only the areas of the widgets which have changed are repainted and copied into the texture.
 */
 
 struct GUI
@@ -27,6 +28,7 @@ struct GUI
 			Clickable = 1,
 			Check = 2, //Some widgets have checked/unchecked state.
 			Visible = 4,
+			Dirty = 8, //The widget's area is to be repainted.
 		};
 		int state; //A bit field storing widget's permanent and temporary properties.
 
@@ -44,6 +46,10 @@ struct GUI
 		{
 			return (x>pos[0] && x<pos[0]+size[0] && y>pos[1] && y<pos[1]+size[1]);
 		}
+		bool contains(const Widget& w)
+		{
+			return (w.pos[0]>=pos[0] && w.pos[0]+w.size[0]<=pos[0]+size[0] && w.pos[1]>=pos[1] && w.pos[1]+w.size[1]<=pos[1]+size[1]);
+		}
 		void setBit(int bit, bool on)
 		{
 			if(on){
@@ -55,6 +61,8 @@ struct GUI
 	};
 	
 	static const int Reso = 512;//Native resolution for the bitmap and texture.
+	static const int Opacity = 200;//Opacity of the widgets, out of 255.
+	static const int FadeSpeed = 1200;//Increase of opacity per second in the 'fade in' effect.
 	HDC dc;
 	HBITMAP bitmap;
 	GLuint texture;
@@ -67,9 +75,9 @@ struct GUI
 	};
 	int screen;//Current GUI screen index: menu, game, session result.
 	
-	bool dirty;//This flag causes all widgets be redrawn on the next refresh.
+	bool dirty;//This flag causes the widgets marked Dirty be redrawn on the next refresh.
 	int widgetAtCursor;//The index of the widget the mouse cursor is hovering over.
-	int opacity;//Whole menu opacity, [0..255], used to animate the 'fade in' effect.
+	int opacity;//Whole menu opacity, [0..Opacity], used to animate the 'fade in' effect. Applied when drawing the texture.
 	
 	enum Widgets {
 		//Menu screen widgets
@@ -82,10 +90,12 @@ struct GUI
 		RandomAI1,
 		HeuristicAI1,
 		MinmaxAI1,
+		MctsAI1,
 		Human2,
 		RandomAI2,
 		HeuristicAI2,
 		MinmaxAI2,
+		MctsAI2,
 		GridSize,
 		GridSize3,
 		GridSize4,
@@ -120,7 +130,7 @@ struct GUI
 		screen = 0;
 		dirty = true;
 		widgetAtCursor = -1;
-		opacity = 200;
+		opacity = Opacity;
 		ZeroMemory(widgets, sizeof(Widget)*NWidgets);
 	}
 	void init()
@@ -139,14 +149,16 @@ struct GUI
 		widgets[Title3   ].init(375,  60, 15, 25, "3",           titleFont3, 0);
 		widgets[Player1  ].init( 90, 120, 90, 40, "Player 1",  font, 0);
 		widgets[Player2  ].init( 90, 170, 90, 40, "Player 2",  font, 0);
-		widgets[Human1   ].init(190, 120, 90, 40, "Human",     font, Widget::Clickable|Widget::Check);
-		widgets[Human2   ].init(190, 170, 90, 40, "Human",     font, Widget::Clickable);
-		widgets[RandomAI1].init(290, 120, 40, 40, "Rnd",  font, Widget::Clickable);
-		widgets[RandomAI2].init(290, 170, 40, 40, "Rnd",  font, Widget::Clickable|Widget::Check);
-		widgets[HeuristicAI1].init(340, 120, 40, 40, "Heu",  font, Widget::Clickable);
-		widgets[HeuristicAI2].init(340, 170, 40, 40, "Heu",  font, Widget::Clickable);
-		widgets[MinmaxAI1].init(390, 120, 40, 40, "MM",  font, Widget::Clickable);
-		widgets[MinmaxAI2].init(390, 170, 40, 40, "MM",  font, Widget::Clickable);
+		widgets[Human1   ].init(185, 120, 75, 40, "Human",     font, Widget::Clickable|Widget::Check);
+		widgets[Human2   ].init(185, 170, 75, 40, "Human",     font, Widget::Clickable);
+		widgets[RandomAI1].init(265, 120, 40, 40, "Rnd",  font, Widget::Clickable);
+		widgets[RandomAI2].init(265, 170, 40, 40, "Rnd",  font, Widget::Clickable|Widget::Check);
+		widgets[HeuristicAI1].init(310, 120, 40, 40, "Heu",  font, Widget::Clickable);
+		widgets[HeuristicAI2].init(310, 170, 40, 40, "Heu",  font, Widget::Clickable);
+		widgets[MinmaxAI1].init(355, 120, 40, 40, "MM",  font, Widget::Clickable);
+		widgets[MinmaxAI2].init(355, 170, 40, 40, "MM",  font, Widget::Clickable);
+		widgets[MctsAI1  ].init(400, 120, 40, 40, "MC",  font, Widget::Clickable);
+		widgets[MctsAI2  ].init(400, 170, 40, 40, "MC",  font, Widget::Clickable);
 		
 		widgets[GridSize ].init( 90, 220, 90, 40, "Grid size", font, 0);
 		widgets[GridSize3].init(190, 220, 40, 40, "3",         font, Widget::Clickable|Widget::Check);
@@ -177,6 +189,8 @@ struct GUI
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+		//The texture is created once, and repainted areas of the bitmap are copied into it.
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, Reso, Reso, 0, GL_BGRA_EXT, GL_UNSIGNED_BYTE, pixels);
 	}
 	void createBitmap()
 	{
@@ -191,10 +205,6 @@ struct GUI
 		bitmap = CreateDIBSection(0, &bi, DIB_RGB_COLORS, (void**)&pixels, NULL, 0);
 		SelectBitmap(dc, bitmap);
 	}
-	void clear()
-	{
-		ZeroMemory(pixels, sizeof(int)*Reso*Reso);
-	}
 	void draw()
 	{
 		if(dirty){
@@ -202,80 +212,136 @@ struct GUI
 			dirty = false;
 		}
 		glBindTexture(GL_TEXTURE_2D, texture);
+		//The vertex color's alpha scales the texture's, to fade the whole GUI in.
+		glColor4f(1, 1, 1, (float)opacity / Opacity);
 		glBegin(GL_TRIANGLE_FAN);
 			glTexCoord2f(0,0); glVertex2f(-1,-1);
 			glTexCoord2f(1,0); glVertex2f( 1,-1);
 			glTexCoord2f(1,1); glVertex2f( 1, 1);
 			glTexCoord2f(0,1); glVertex2f(-1, 1);
 		glEnd();
-
-		if(opacity < 200){//Animate the 'fade in' effect. GUI transitions from transparent to opaque across multiple frames.
-			opacity += 20;
-			dirty = true;
+		glColor4f(1, 1, 1, 1);
+	}
+	//Animate the 'fade in' effect, given the time since the previous frame in seconds.
+	//GUI transitions from transparent to opaque across multiple frames.
+	void animate(float dt)
+	{
+		if(isFading()){
+			int step = (int)(FadeSpeed * dt);
+			opacity = (opacity + step < Opacity) ? opacity + (step > 0 ? step : 1) : Opacity;
 		}
 	}
+	bool isFading()
+	{
+		return opacity < Opacity;
+	}
+	//Repaint the areas of the widgets marked Dirty.
 	void repaint()
 	{
-		clear();
+		for(int i=0; i<NWidgets; i++){
+			if(! (widgets[i].state & Widget::Dirty)){
+				continue;
+			}
+			//An area inside another one being repainted is done with it.
+			bool covered = false;
+			for(int j=0; j<NWidgets && ! covered; j++){
+				if(j != i && (widgets[j].state & Widget::Dirty) && widgets[j].contains(widgets[i])){
+					covered = (j < i || ! widgets[i].contains(widgets[j]));//Of two equal areas, the first one is repainted.
+				}
+			}
+			if(! covered){
+				const Widget& w = widgets[i];
+				repaintArea(w.pos[0], w.pos[1], w.pos[0]+w.size[0], w.pos[1]+w.size[1]);
+			}
+		}
+		for(int i=0; i<NWidgets; i++){
+			widgets[i].setBit(Widget::Dirty, false);
+		}
+	}
+	//Repaint a rectangle of the bitmap, from (x0,y0) to (x1,y1) exclusive, with all the visible widgets in it,
+	//and copy it into the texture.
+	void repaintArea(int x0, int y0, int x1, int y1)
+	{
+		x0 = (x0 > 0) ? x0 : 0;
+		y0 = (y0 > 0) ? y0 : 0;
+		x1 = (x1 < Reso) ? x1 : Reso;
+		y1 = (y1 < Reso) ? y1 : Reso;
+		if(x0 >= x1 || y0 >= y1){
+			return;
+		}
+		fillArea(x0, y0, x1, y1, 0, 0, 0);
+		setAlpha(x0, y0, x1, y1, 0);
+		IntersectClipRect(dc, x0, y0, x1, y1);//Text is drawn only within the area, too.
 		for(int i=0; i<NWidgets; i++){
 			Widget& w = widgets[i];
 			if(! (w.state & Widget::Visible)){
 				continue;
 			}
-			for(int y=0; y<w.size[1]; y++){
-				for(int x=0; x<w.size[0]; x++){
-					int X = x + w.pos[0];
-					int Y = Reso-1 - (y + w.pos[1]);
-					if(w.state & Widget::Check){
-						if(i>=Human1 && i<=MinmaxAI1){
-							//Paint Human/Computer switch buttons for Player1 with Player1's color.
-							pixels[X+Y*Reso].R = 250;
-							pixels[X+Y*Reso].G = 50;
-							pixels[X+Y*Reso].B = 50;
-						}else if(i>=Human2 && i<=MinmaxAI2){
-							//Paint Human/Computer switch buttons fro Player2 with Player2's color.
-							pixels[X+Y*Reso].R = 100;
-							pixels[X+Y*Reso].G = 100;
-							pixels[X+Y*Reso].B = 250;
-						}else{
-							//Paint generic switch button.
-							pixels[X+Y*Reso].R = 50;
-							pixels[X+Y*Reso].G = 200;
-							pixels[X+Y*Reso].B = 50;
-						}
-					}else if(w.state & Widget::Clickable){
-						if(i == widgetAtCursor){
-							//Slightly highight button under the mouse cursor.
-							pixels[X+Y*Reso].R = 200;
-							pixels[X+Y*Reso].G = 200;
-							pixels[X+Y*Reso].B = 200;
-						}else{
-							//Default button color.
-							pixels[X+Y*Reso].R = 170;
-							pixels[X+Y*Reso].G = 170;
-							pixels[X+Y*Reso].B = 170;
-						}
-					}else{
-						//Default widget color (label and backdrop widgets).
-						pixels[X+Y*Reso].R = 250;
-						pixels[X+Y*Reso].G = 250;
-						pixels[X+Y*Reso].B = 250;
-					}
+			//The part of the widget inside the area.
+			const int X0 = (w.pos[0] > x0) ? w.pos[0] : x0;
+			const int Y0 = (w.pos[1] > y0) ? w.pos[1] : y0;
+			const int X1 = (w.pos[0]+w.size[0] < x1) ? w.pos[0]+w.size[0] : x1;
+			const int Y1 = (w.pos[1]+w.size[1] < y1) ? w.pos[1]+w.size[1] : y1;
+			if(X0 >= X1 || Y0 >= Y1){
+				continue;
+			}
+			if(w.state & Widget::Check){
+				if(i>=Human1 && i<=MctsAI1){
+					//Paint Human/Computer switch buttons for Player1 with Player1's color.
+					fillArea(X0, Y0, X1, Y1, 250, 50, 50);
+				}else if(i>=Human2 && i<=MctsAI2){
+					//Paint Human/Computer switch buttons fro Player2 with Player2's color.
+					fillArea(X0, Y0, X1, Y1, 100, 100, 250);
+				}else{
+					//Paint generic switch button.
+					fillArea(X0, Y0, X1, Y1, 50, 200, 50);
 				}
+			}else if(w.state & Widget::Clickable){
+				if(i == widgetAtCursor){
+					//Slightly highight button under the mouse cursor.
+					fillArea(X0, Y0, X1, Y1, 200, 200, 200);
+				}else{
+					//Default button color.
+					fillArea(X0, Y0, X1, Y1, 170, 170, 170);
+				}
+			}else{
+				//Default widget color (label and backdrop widgets).
+				fillArea(X0, Y0, X1, Y1, 250, 250, 250);
 			}
 			if(w.text){
 				SelectFont(dc, w.font);
 				drawTextXY(w.pos[0]+w.size[0]/2, w.pos[1]+w.size[1]/2, w.text);
+				GdiFlush();//Let GDI finish drawing before the pixels are accessed.
 			}
-			for(int y=0; y<w.size[1]; y++){
-				for(int x=0; x<w.size[0]; x++){
-					int X = x + w.pos[0];
-					int Y = Reso-1 - (y + w.pos[1]);
-					pixels[X+Y*Reso].A = opacity;
-				}
+			setAlpha(X0, Y0, X1, Y1, Opacity);
+		}
+		SelectClipRgn(dc, NULL);
+		//The bitmap is stored bottom-up, and so is the texture: row 0 is the bottom one.
+		glBindTexture(GL_TEXTURE_2D, texture);
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, Reso);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, x0, Reso-y1, x1-x0, y1-y0, GL_BGRA_EXT, GL_UNSIGNED_BYTE, &pixels[x0 + (Reso-y1)*Reso]);
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	}
+	//Set the color of a rectangle of pixels. The coordinates are from the top of the bitmap, like the widgets'.
+	void fillArea(int x0, int y0, int x1, int y1, unsigned char R, unsigned char G, unsigned char B)
+	{
+		for(int y=y0; y<y1; y++){
+			RGBA* row = &pixels[(Reso-1 - y)*Reso];
+			for(int x=x0; x<x1; x++){
+				row[x].R = R;
+				row[x].G = G;
+				row[x].B = B;
+			}
+		}
+	}
+	void setAlpha(int x0, int y0, int x1, int y1, unsigned char A)
+	{
+		for(int y=y0; y<y1; y++){
+			RGBA* row = &pixels[(Reso-1 - y)*Reso];
+			for(int x=x0; x<x1; x++){
+				row[x].A = A;
 			}
 		}
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, Reso, Reso, 0, GL_BGRA_EXT, GL_UNSIGNED_BYTE, pixels);
 	}
 	void drawTextXY(int x, int y, const char* text)
 	{
@@ -288,13 +354,13 @@ struct GUI
 	void onMouseDown(int x, int y, RECT& clientRect)
 	{
 		int w = widgetAtCursor;
-		if(w>=Human1 && w<=MinmaxAI1){
-			for(int i=Human1; i<=MinmaxAI1; i++){
+		if(w>=Human1 && w<=MctsAI1){
+			for(int i=Human1; i<=MctsAI1; i++){
 				setWidgetCheck(i, w==i);
 			}
 		}
-		if(w>=Human2 && w<=MinmaxAI2){
-			for(int i=Human2; i<=MinmaxAI2; i++){
+		if(w>=Human2 && w<=MctsAI2){
+			for(int i=Human2; i<=MctsAI2; i++){
 				setWidgetCheck(i, w==i);
 			}
 		}
@@ -337,8 +403,13 @@ struct GUI
 		//Determine widget under the cursor.
 		int wat = getWidgetAtPoint(x, y);
 		if(wat != widgetAtCursor){
+			if(widgetAtCursor >= 0){
+				setWidgetDirty(widgetAtCursor);
+			}
+			if(wat >= 0){
+				setWidgetDirty(wat);
+			}
 			widgetAtCursor = wat;
-			dirty = true;
 		}
 	}
 	int getWidgetAtPoint(int x, int y)
@@ -367,53 +438,55 @@ struct GUI
 		if(scr != screen){
 			for(int w=0; w<NWidgets; w++){
 				if(w < Back){
-					widgets[w].setBit(Widget::Visible, scr==MainMenu);
+					setWidgetVisible(w, scr==MainMenu);
 				}else if(w < ResultBG){
-					widgets[w].setBit(Widget::Visible, scr==Game);
+					setWidgetVisible(w, scr==Game);
 				}else{
-					widgets[w].setBit(Widget::Visible, scr==Result);
+					setWidgetVisible(w, scr==Result);
 				}
 			}
 			//These two widgets are invisible by default, toggled by the game logic.
-			widgets[GoPlayer1].setBit(Widget::Visible, false);
-			widgets[GoPlayer2].setBit(Widget::Visible, false);
+			setWidgetVisible(GoPlayer1, false);
+			setWidgetVisible(GoPlayer2, false);
 			screen = scr;
 			opacity = 0;//Start GUI "fade in" animation.
-			dirty = true;
 		}
 	}
+	//Mark the widget's area to be repainted on the next refresh.
+	void setWidgetDirty(int w)
+	{
+		widgets[w].setBit(Widget::Dirty, true);
+		dirty = true;
+	}
 	void setWidgetClickable(int w, bool value)
 	{
 		if(!!(widgets[w].state & Widget::Clickable) != value){
 			widgets[w].setBit(Widget::Clickable, value);
-			dirty = true;
+			setWidgetDirty(w);
 		}
 	}
 	void setWidgetCheck(int w, bool value)
 	{
 		if(!!(widgets[w].state & Widget::Check) != value){
 			widgets[w].setBit(Widget::Check, value);
-			dirty = true;
+			setWidgetDirty(w);
 		}
 	}
 	void setWidgetVisible(int w, bool value)
 	{
 		if(!!(widgets[w].state & Widget::Visible) != value){
 			widgets[w].setBit(Widget::Visible, value);
-			dirty = true;
+			setWidgetDirty(w);
 		}
 	}
 	void setWidgetText(int w, const char* text)
 	{
 		widgets[w].text = text;
-		dirty = true;
+		setWidgetDirty(w);
 	}
 	void setOpacity(int opa)
 	{
-		if(opa != opacity){
-			opacity = opa;
-			dirty = true;
-		}
+		opacity = opa;
 	}
 	int getGridSize()
 	{
@@ -436,14 +509,14 @@ struct GUI
 	int getPlayerType(int player)
 	{
 		if(player == 1){
-			for(int i=Human1; i<=MinmaxAI1; i++){
+			for(int i=Human1; i<=MctsAI1; i++){
 				if(widgets[i].state & Widget::Check){
 					return i-Human1;
 				}
 			}
 		}
 		if(player == 2){
-			for(int i=Human2; i<=MinmaxAI2; i++){
+			for(int i=Human2; i<=MctsAI2; i++){
 				if(widgets[i].state & Widget::Check){
 					return i-Human2;
 				}
@@ -1,7 +1,19 @@
 #pragma once
 
 #include <stdlib.h>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <memory>
 #include "Array3.h"
+#include "Bitboard.h"
+#include "TranspositionTable.h"
+#include "Symmetry.h"
+#include "SearchStats.h"
+#include "LineKernels.h"
+#include "SolutionTable.h"
 
 //To test all posible rows and diagonals, you have to go in 13 directions from each cell.
 static const int nLineDirs = 13;
@@ -26,83 +38,307 @@ struct Game
 {
 	int size;//Grid size.
 	int nToWin;//Winning combination length.
-	Array3<int> contents;//Cell contents: empty (0), Player 1 mark (1), Player 2 mark (2)
-	Array3<int> winning;//Used to highlight cells comprising the winning combinations.
+	//Cells are stored as bytes, so that a whole 6x6x6 grid takes 4 cache lines instead of 14.
+	//They are kept inside the Game object, so copying a position doesn't touch the heap.
+	Array3<uint8_t, 6*6*6> contents;//Cell contents: empty (0), Player 1 mark (1), Player 2 mark (2)
+	Array3<uint8_t, 6*6*6> winning;//Used to highlight cells comprising the winning combinations.
+	Array3<int> weight;//Scratch space for heuristicMove(), kept so that it doesn't allocate on every move.
+	std::vector<unsigned char> lineWeight;//Same, the weights of the lines.
+	Bitboard marks[3];//Cells occupied by Player 1 (marks[1]) and Player 2 (marks[2]), mirroring contents. marks[0] is unused.
+
+	//Table of all possible winning lines for the current grid size and winning combination length.
+	//Built once per configuration in reset(), so the evaluation routines don't have to walk
+	//13 directions from every cell and discard the lines falling off the grid.
+	int nLines;//Number of lines fitting in the grid.
+	std::vector<int> lineCells;//Cell indices of every line, nToWin consecutive entries per line.
+	std::vector<int> lineCellsByPosition;//The same transposed: the first cells of all lines, then the second cells, etc.
+	std::vector<int> cellLinesStart;//Offsets into cellLines for each cell, bufferSize()+1 entries.
+	std::vector<int> cellLines;//Indices of the lines passing through each cell.
+	std::vector<Bitboard> lineMasks;//The cells of every line as a bit mask.
+
+	//Incrementally maintained by applyMove() and undoMove().
+	//Number of each player's marks in every line. lineCount[0] is unused.
+	//Padded with zeros to whole blocks of LineKernels.
+	std::vector<unsigned char> lineCount[3];
+	int nLiveLines;//Number of lines that can still become winning. The game is a draw when it drops to zero.
+	int evaluation;//Static evaluation of the position for Player 1: sum of lineValue over all lines.
+
+	//Value of a line for Player 1, indexed by the number of Player 1 and Player 2 marks in it.
+	//Same idea as the cell weights in heuristicMove(): a line occupied by one player only is worth
+	//more the closer it is to completion, and a line with both players' marks is worthless.
+	int lineValue[7][7];
+
+	//Zobrist hashing: every (cell, player) pair has a random key, and the position's hash is
+	//the XOR of the keys of all occupied cells. Updated with 2 XORs per move in setCell().
+	uint64_t hashKeys[3][256];//hashKeys[0] is unused.
+	uint64_t emptyHash;//Hash of the empty grid.
+	uint64_t hash;
+
+	TranspositionTable* tt;//Optional cache of search results. Set by the owner, who keeps it between moves.
+	SolutionTable* solutions;//Optional table of solved positions, looked up by minmaxMove() before searching.
+
+	Symmetry symmetry;//Rotations and reflections of the grid as cell permutations.
+	int history[256];//Cells filled by applyMove(), in the order of moves.
+	int nMoves;
+	int rootSymmetries[Symmetry::NSymmetries];//Symmetries leaving the position at the search root unchanged.
+	int nRootSymmetries;
+
+	//Time control of the search in minmaxMove().
+	std::chrono::steady_clock::time_point deadline;
+	bool timeLimited;//Set when the search may be stopped by the deadline.
+	bool stopSearch;//Set when the deadline has passed, the search then unwinds and its results are discarded.
+	unsigned nodeCounter;//The clock is only checked every few nodes.
+	int rootMove;//Best move found by the previous iteration, searched first by the next one.
+	std::atomic<bool>* abortSearch;//Optional flag set by another thread to stop the search.
+	int searchThreads;//Number of threads searching in minmaxMove(), including the calling one.
+	//Lazy SMP helper games and their threads. The games are kept between searches, so that only the position
+	//is copied into them for every move, and they are resized only when the grid size changes.
+	std::vector<std::unique_ptr<Game>> helpers;
+	std::vector<std::thread> helperThreads;
+	SearchStats stats;//Statistics of the latest minmaxMove() search.
+	std::function<void(const SearchStats&)> onSearchInfo;//Optional, called with the statistics after every iteration.
+
+	//Move ordering. The sooner the best move is tried, the more branches alpha-beta cuts off.
+	int killers[256][2];//Per ply, the latest two quiet moves which caused a cutoff.
+	int historyScore[3][256];//Per player and cell, how often moving there caused a cutoff, weighted by depth.
+	std::vector<int> moveStack;//Candidate moves of the nodes on the current search path.
+	std::vector<int> moveScoreStack;//Their ordering scores.
+	int cellScore[256];//Scratch space for generateMoves().
+	int moveStackTop;
+
+	//The hot routines are templates on the grid size and the winning combination length, and are
+	//instantiated for every configuration offered by the menu. With the bounds of the loops over the grid
+	//and over the cells of a line known at compile time, the compiler can unroll them.
+	//The instances for the current configuration are selected in reset(). Template arguments of 0
+	//make the generic instance, which reads the configuration at run time.
+	int (Game::*heuristicMoveImpl)(int player);
+	int (Game::*generateMovesImpl)(int turn, int ply, int ttMove, int* moves, int* scores);
+
+	//Random number generator of the random and heuristic AIs. Each game has its own, unlike rand(),
+	//so that games played on different threads don't interfere and can be replayed from their seeds.
+	uint64_t randomState;
 
 	Game()
 	{
 		size = 0;
+		nToWin = 0;
+		nLines = 0;
+		nLiveLines = 0;
+		evaluation = 0;
+		tt = 0;
+		solutions = 0;
+		nMoves = 0;
+		nRootSymmetries = 0;
+		timeLimited = false;
+		stopSearch = false;
+		nodeCounter = 0;
+		rootMove = -1;
+		abortSearch = 0;
+		searchThreads = 1;
+		moveStackTop = 0;
+		setKernels<0, 0>();
+		clearMoveOrdering();
+		//The keys are generated with a fixed seed xorshift generator so as not to disturb rand().
+		uint64_t x = 0x9E3779B97F4A7C15ull;
+		for(int p=0; p<3; p++){
+			for(int c=0; c<256; c++){
+				x ^= x << 13;
+				x ^= x >> 7;
+				x ^= x << 17;
+				hashKeys[p][c] = x;
+			}
+		}
+		emptyHash = hashKeys[0][0];
+		hash = emptyHash;
+		seedRandom(1);
+	}
+	void seedRandom(uint64_t seed)
+	{
+		randomState = seed * 0x2545F4914F6CDD1Dull | 1;//xorshift state must not be zero.
+	}
+	//Random integer in range [0, n).
+	int randomInt(int n)
+	{
+		randomState ^= randomState << 13;
+		randomState ^= randomState >> 7;
+		randomState ^= randomState << 17;
+		return (int)((randomState >> 32) * n >> 32);
 	}
 	void reset(int sz, int ntw)
 	{
+		bool configChanged = (size != sz || nToWin != ntw);
 		if(size != sz){
 			//If requested different grid size, allocate new arrays.
 			size = sz;
 			contents.allocate(size);
 			winning.allocate(size);
+			weight.allocate(size);
+			symmetry.build(size);
+			//Each node on the search path keeps up to one move per empty cell.
+			const int nCells = contents.bufferSize();
+			moveStack.resize(nCells*(nCells+1)/2);
+			moveScoreStack.resize(nCells*(nCells+1)/2);
+			SEARCH_STAT(stats.pv.reserve(nCells));
 		}
 		nToWin = ntw;
+		if(configChanged){
+			buildLines();
+			selectKernels();
+		}
 		contents.set(0);
 		winning.set(0);
+		marks[1].clear();
+		marks[2].clear();
+		lineCount[1].assign(LineKernels::paddedSize(nLines), 0);
+		lineCount[2].assign(LineKernels::paddedSize(nLines), 0);
+		nLiveLines = nLines;
+		evaluation = 0;
+		hash = emptyHash;
+		nMoves = 0;
+		nRootSymmetries = 0;
+		if(tt){
+			tt->clear();
+		}
 	}
-	void markWinningLine(int i, int j, int k, const int dir[3])
+	//Make this game a copy of the other one's position, by replaying its moves.
+	//The copy can then be searched on another thread. The transposition table is left unset.
+	void copyFrom(Game& other)
 	{
-		for(int t=0; t<nToWin; t++){
-			winning(i,j,k) = true;
-			i += dir[0];
-			j += dir[1];
-			k += dir[2];
+		tt = 0;
+		reset(other.size, other.nToWin);
+		for(int m=0; m<other.nMoves; m++){
+			applyMove(other.history[m], other.contents[other.history[m]]);
 		}
 	}
-	//Calculate the number of non-empty cells in a line. Used in the heuristic algorithm.
-	int getNumMarksInLine(int i, int j, int k, const int dir[3])
+	//Put a player's mark into the cell, or clear it with player = 0.
+	//Keeps the bitboards in sync, but not the line counts. Moves shall be made with applyMove().
+	void setCell(int cell, int player)
 	{
-		int n = 0;
-		for(int t=0; t<nToWin; t++){
-			if(contents(i,j,k)){
-				++n;
-			}
-			i += dir[0];
-			j += dir[1];
-			k += dir[2];
+		if(contents[cell]){
+			marks[contents[cell]].reset(cell);
+			hash ^= hashKeys[contents[cell]][cell];
 		}
-		return n;
+		if(player){
+			marks[player].set(cell);
+			hash ^= hashKeys[player][cell];
+		}
+		contents[cell] = (uint8_t)player;
 	}
-	//Check if the line can become winning after 1 or more moves.
-	//A potential winning line can only have empty cells or marks of the same player.
-	bool isLinePotentialWin(int i, int j, int k, const int dir[3])
+	void buildLines()
 	{
-		int combination = 0;
-		for(int t=0; t<nToWin; t++){
-			if(i<0 || i>=size) return false;
-			if(j<0 || j>=size) return false;
-			if(k<0 || k>=size) return false;
-			combination |= contents(i,j,k);
-			if(combination >= 3){
-				return false;
+		const int nCells = contents.bufferSize();
+		lineCells.clear();
+		std::vector<int> nCellLines(nCells, 0);
+		for(int k=0; k<size; k++){
+		for(int j=0; j<size; j++){
+		for(int i=0; i<size; i++){
+			for(int d=0; d<nLineDirs; d++){
+				//A line fits in the grid if both its ends do.
+				int i1 = i + lineDirs[d][0] * (nToWin-1);
+				int j1 = j + lineDirs[d][1] * (nToWin-1);
+				int k1 = k + lineDirs[d][2] * (nToWin-1);
+				if(i1<0 || i1>=size) continue;
+				if(j1<0 || j1>=size) continue;
+				if(k1<0 || k1>=size) continue;
+				for(int t=0; t<nToWin; t++){
+					int cell = contents.index(i + lineDirs[d][0]*t, j + lineDirs[d][1]*t, k + lineDirs[d][2]*t);
+					lineCells.push_back(cell);
+					++nCellLines[cell];
+				}
+			}
+		}
+		}
+		}
+		nLines = (int)lineCells.size() / nToWin;
+		lineCellsByPosition.resize(lineCells.size());
+		for(int l=0; l<nLines; l++){
+			for(int t=0; t<nToWin; t++){
+				lineCellsByPosition[t*nLines + l] = lineCells[l*nToWin + t];
+			}
+		}
+		lineWeight.assign(LineKernels::paddedSize(nLines), 0);
+		lineMasks.resize(nLines);
+		for(int l=0; l<nLines; l++){
+			lineMasks[l].clear();
+			for(int t=0; t<nToWin; t++){
+				lineMasks[l].set(lineCells[l*nToWin+t]);
+			}
+		}
+
+		for(int n1=0; n1<=nToWin; n1++){
+			for(int n2=0; n2<=nToWin; n2++){
+				int value = 0;
+				if(n2 == 0 && n1 > 0){
+					value = 1 << (3*(n1-1));
+				}
+				if(n1 == 0 && n2 > 0){
+					value = -(1 << (3*(n2-1)));
+				}
+				lineValue[n1][n2] = value;
+			}
+		}
+
+		//Invert the table to get the list of lines for each cell.
+		cellLinesStart.assign(nCells+1, 0);
+		for(int c=0; c<nCells; c++){
+			cellLinesStart[c+1] = cellLinesStart[c] + nCellLines[c];
+		}
+		cellLines.resize(cellLinesStart[nCells]);
+		std::vector<int> fill(cellLinesStart.begin(), cellLinesStart.end()-1);
+		for(int l=0; l<nLines; l++){
+			for(int t=0; t<nToWin; t++){
+				cellLines[fill[lineCells[l*nToWin+t]]++] = l;
 			}
-			i += dir[0];
-			j += dir[1];
-			k += dir[2];
 		}
-		return true;
 	}
-	//Check if all cells comprising the line hold the same value.
-	bool isLineAllTheSame(int i, int j, int k, const int dir[3])
+	template<int Size, int ToWin>
+	void setKernels()
 	{
-		int player = contents(i,j,k);
+		heuristicMoveImpl = &Game::heuristicMoveKernel<Size, ToWin>;
+		generateMovesImpl = &Game::generateMovesKernel<Size, ToWin>;
+	}
+	template<int Size>
+	void selectKernels()
+	{
+		switch(nToWin){
+		case 3: setKernels<Size, 3>(); break;
+		case 4: setKernels<Size, 4>(); break;
+		case 5: setKernels<Size, 5>(); break;
+		case 6: setKernels<Size, 6>(); break;
+		default: setKernels<0, 0>(); break;
+		}
+	}
+	void selectKernels()
+	{
+		switch(size){
+		case 3: selectKernels<3>(); break;
+		case 4: selectKernels<4>(); break;
+		case 5: selectKernels<5>(); break;
+		case 6: selectKernels<6>(); break;
+		default: setKernels<0, 0>(); break;
+		}
+	}
+	const int* getLine(int line)
+	{
+		return &lineCells[line*nToWin];
+	}
+	void markWinningLine(int line)
+	{
+		const int* cells = getLine(line);
 		for(int t=0; t<nToWin; t++){
-			if(i<0 || i>=size) return false;
-			if(j<0 || j>=size) return false;
-			if(k<0 || k>=size) return false;
-			if(contents(i,j,k) != player){
-				return false;
-			}
-			i += dir[0];
-			j += dir[1];
-			k += dir[2];
+			winning[cells[t]] = 1;
 		}
-		return true;
+	}
+	//Check if the line can become winning after 1 or more moves.
+	//A potential winning line can only have empty cells or marks of the same player.
+	bool isLinePotentialWin(int line)
+	{
+		return ! marks[1].intersects(lineMasks[line]) || ! marks[2].intersects(lineMasks[line]);
+	}
+	//Check if all cells comprising the line hold the given player's marks.
+	bool isLineWon(int line, int player)
+	{
+		return marks[player].containsAll(lineMasks[line]);
 	}
 	//Examine the current state of the field and determine the victory, draw or non-final state.
 	//Return value:
@@ -113,42 +349,70 @@ struct Game
 	int checkGameState()
 	{
 		int draw = 3;
-		for(int k=0; k<size; k++){
-		for(int j=0; j<size; j++){
-		for(int i=0; i<size; i++){
-			if(contents(i,j,k)){
-				for(int d=0; d<nLineDirs; d++){
-					if(isLineAllTheSame(i,j,k,lineDirs[d])){
-						return contents(i,j,k);//Return winning player.
-					}
+		for(int l=0; l<nLines; l++){
+			for(int p=1; p<=2; p++){
+				if(isLineWon(l, p)){
+					return p;//Return winning player.
 				}
 			}
-			for(int d=0; d<nLineDirs; d++){
-				if(isLinePotentialWin(i,j,k,lineDirs[d])){
-					draw = 0;//At least one potential winning line removes the possibility of draw.
-				}
+			if(draw && isLinePotentialWin(l)){
+				draw = 0;//At least one potential winning line removes the possibility of draw.
 			}
 		}
+		return draw;
+	}
+	//Put the player's mark into an empty cell and update the game state incrementally.
+	//Only the lines through that cell are examined, so the cost doesn't depend on the grid size.
+	//Assumes the game wasn't over before the move.
+	//Return value is the same as in checkGameState().
+	int applyMove(int cell, int player)
+	{
+		setCell(cell, player);
+		history[nMoves++] = cell;
+		int state = 0;
+		const int opponent = 3-player;
+		for(int c=cellLinesStart[cell]; c<cellLinesStart[cell+1]; c++){
+			const int l = cellLines[c];
+			evaluation -= lineValue[lineCount[1][l]][lineCount[2][l]];
+			int n = ++lineCount[player][l];
+			evaluation += lineValue[lineCount[1][l]][lineCount[2][l]];
+			if(n == nToWin){
+				state = player;
+			}
+			if(n == 1 && lineCount[opponent][l]){
+				--nLiveLines;//The line now has both players' marks.
+			}
 		}
+		if(state == 0 && nLiveLines == 0){
+			state = 3;
 		}
-		return draw;
+		return state;
+	}
+	//Take back the latest move made with applyMove().
+	void undoMove(int cell)
+	{
+		const int player = contents[cell];
+		const int opponent = 3-player;
+		for(int c=cellLinesStart[cell]; c<cellLinesStart[cell+1]; c++){
+			const int l = cellLines[c];
+			evaluation -= lineValue[lineCount[1][l]][lineCount[2][l]];
+			int n = lineCount[player][l]--;
+			evaluation += lineValue[lineCount[1][l]][lineCount[2][l]];
+			if(n == 1 && lineCount[opponent][l]){
+				++nLiveLines;
+			}
+		}
+		setCell(cell, 0);
+		--nMoves;
 	}
 
 	void markWinningLines()
 	{
-		for(int k=0; k<size; k++){
-		for(int j=0; j<size; j++){
-		for(int i=0; i<size; i++){
-			if(contents(i,j,k)){
-				for(int d=0; d<nLineDirs; d++){
-					if(isLineAllTheSame(i,j,k,lineDirs[d])){
-						markWinningLine(i,j,k,lineDirs[d]);
-					}
-				}
+		for(int l=0; l<nLines; l++){
+			if(isLineWon(l, 1) || isLineWon(l, 2)){
+				markWinningLine(l);
 			}
 		}
-		}
-		}
 	}
 
 	
@@ -176,62 +440,55 @@ struct Game
 	*/
 	int heuristicMove(int player)
 	{
-		//First, check the winning conditions
-		for(int k=0; k<size; k++){
-		for(int j=0; j<size; j++){
-		for(int i=0; i<size; i++){
-			for(int d=0; d<nLineDirs; d++){
-				if(isLinePotentialWin(i,j,k,lineDirs[d])){
-					if(getNumMarksInLine(i,j,k,lineDirs[d]) == nToWin-1){//The line is one step from winning.
-						int i1 = i;
-						int j1 = j;
-						int k1 = k;
-						for(int t=0; t<nToWin; t++){
-							if(! contents(i1,j1,k1)){
-								return contents.index(i1, j1, k1);//Return the only empty cell in this line.
-							}
-							i1 += lineDirs[d][0];
-							j1 += lineDirs[d][1];
-							k1 += lineDirs[d][2];
+		return (this->*heuristicMoveImpl)(player);
+	}
+	template<int Size, int ToWin>
+	int heuristicMoveKernel(int player)
+	{
+		const int nCells = Size ? Size*Size*Size : contents.bufferSize();
+		const int toWin = ToWin ? ToWin : nToWin;
+		//The number of marks in the lines is known from the line counts.
+		//The weight of a line is the number of its marks, or 0 if it has mixed marks and can't ever become winning.
+		//Lines are weighed in blocks with LineKernels, which also finds the lines one step from winning.
+		const unsigned char* count1 = lineCount[1].data();
+		const unsigned char* count2 = lineCount[2].data();
+		unsigned char* lineW = lineWeight.data();
+		for(int l=0; l<nLines; l+=LineKernels::Block){
+			int oneShort = LineKernels::weighLines(count1 + l, count2 + l, toWin, lineW + l);
+			//First, check the winning conditions
+			for(int b=0; oneShort; b++, oneShort >>= 1){
+				if((oneShort & 1) && l+b < nLines){
+					const int* cells = getLine(l+b);
+					for(int t=0; t<toWin; t++){
+						if(! contents[cells[t]]){
+							return cells[t];//Return the only empty cell in this line.
 						}
 					}
 				}
 			}
 		}
-		}
-		}
 		
-		//Calculate importance or "weight" of empty cells.
-		Array3<int> weight(size);
-		weight.set(0);
-		for(int k=0; k<size; k++){
-		for(int j=0; j<size; j++){
-		for(int i=0; i<size; i++){
-			for(int d=0; d<nLineDirs; d++){
-				if(! isLinePotentialWin(i,j,k,lineDirs[d])){
-					continue; //Skip lines that have mixed marks and can't ever become winning.
-				}
-				int i1 = i;
-				int j1 = j;
-				int k1 = k;
-				int w = getNumMarksInLine(i,j,k,lineDirs[d]);
-				for(int t=0; t<nToWin; t++){
-					if(! contents(i1,j1,k1)){
-						weight(i1,j1,k1) += w;
-					}
-					i1 += lineDirs[d][0];
-					j1 += lineDirs[d][1];
-					k1 += lineDirs[d][2];
-				}
-			}
-		}
+		//Calculate importance or "weight" of empty cells: the sum of the weights of the lines through it.
+		//The weights are added to all cells of the lines, the occupied cells are discarded below.
+		for(int i=0; i<nCells; i++){
+			weight[i] = 0;
 		}
+		for(int t=0; t<toWin; t++){
+			const int* cells = &lineCellsByPosition[t*nLines];
+			for(int l=0; l<nLines; l++){
+				weight[cells[l]] += lineW[l];
+			}
 		}
 		
 		//Calculate the number of cells with the maximum weight.
+		//Occupied cells are excluded, they weigh 0 just like empty cells on empty lines.
 		int maxW = 0;
 		int nMaxW = 0;
-		for(int i=0; i<size*size*size; i++){
+		for(int i=0; i<nCells; i++){
+			if(contents[i]){
+				weight[i] = -1;
+				continue;
+			}
 			if(weight[i] > maxW){
 				maxW = weight[i];
 				nMaxW = 0;
@@ -241,12 +498,10 @@ struct Game
 			}
 		}
 		//Pick one of those cells randomly.
-		int k = nMaxW*rand()/RAND_MAX;
-		if(k >= nMaxW) k = nMaxW-1;
-		for(int i=0; i<size*size*size; i++){
+		int k = randomInt(nMaxW);
+		for(int i=0; i<nCells; i++){
 			if(weight[i] == maxW){
-				--k;
-				if(k <= 0){
+				if(k-- == 0){
 					return i;
 				}
 			}
@@ -264,12 +519,10 @@ struct Game
 				++nEmptyCells;
 			}
 		}
-		int k = nEmptyCells * rand() / RAND_MAX;
-		if(k >= nEmptyCells) k = nEmptyCells - 1;
+		int k = randomInt(nEmptyCells);
 		for(int i=0; i<contents.bufferSize(); i++){
 			if(contents[i] == 0){
-				--k;
-				if(k <= 0){
+				if(k-- == 0){
 					return i;
 				}
 			}
@@ -278,58 +531,436 @@ struct Game
 	}
 	
 	
-	//Minmax routine.
-	//Theoretically, makes a perfect player.
-	//But it's unacceptably slow with depth > 3 even on a 3x3x3 grid.
-	int minmax(int player, int turn, int& move, int depth)
+	static const int WinScore = 1000000;//Score of a won game, reduced by the number of moves it took to win.
+
+	//Static evaluation of the position from the given player's point of view.
+	int evaluate(int player)
 	{
-		static const int winScore = 1;
-		if(depth <= 0){
-			move = 0;
-			return 0;
+		return (player == 1) ? evaluation : -evaluation;
+	}
+
+	//Positions with up to this many marks are looked up in the transposition table by their canonical hash.
+	//Early in the game most positions are reached in several symmetric variants, later it's rare
+	//and not worth the cost of computing the canonical form.
+	static const int SymmetryMaxMoves = 8;
+
+	//Hash of the position's canonical form, the symmetric variant with the lowest hash.
+	//Also returns the symmetry that transforms the position into its canonical form.
+	uint64_t canonicalHash(int& sym)
+	{
+		uint64_t best = hash;
+		sym = 0;
+		for(int s=1; s<Symmetry::NSymmetries; s++){
+			uint64_t h = emptyHash;
+			for(int m=0; m<nMoves; m++){
+				h ^= hashKeys[contents[history[m]]][symmetry.apply(s, history[m])];
+			}
+			if(h < best){
+				best = h;
+				sym = s;
+			}
 		}
-		int best = (turn == player) ? INT_MIN : INT_MAX;
-		for(int i=0; i<contents.bufferSize(); i++){
-			if(contents[i] == 0){
-				contents[i] = turn;
-				int score = 0;
-				int winner = checkGameState();
-				if(winner == 0){//Non-final state, invoke minmax on it.
-					int move = 0;
-					score = minmax(player, 3-turn, move, depth-1);
-				}else if(winner == 3){//Draw
-					score = 0;
-				}else{//Either the player or the opponent wins.
-					score = (winner == player) ? winScore : -winScore;
+		return best;
+	}
+	//Find the symmetries which leave the current position unchanged.
+	//Moves which such symmetries map into one another are equivalent and only need to be searched once.
+	void findRootSymmetries()
+	{
+		nRootSymmetries = 0;
+		for(int s=1; s<Symmetry::NSymmetries; s++){
+			bool same = true;
+			for(int m=0; m<nMoves && same; m++){
+				same = (contents[symmetry.apply(s, history[m])] == contents[history[m]]);
+			}
+			if(same){
+				rootSymmetries[nRootSymmetries++] = s;
+			}
+		}
+	}
+	//Check if the root move is equivalent to another one with lower index, which is searched instead.
+	bool isSymmetricDuplicate(int cell)
+	{
+		for(int r=0; r<nRootSymmetries; r++){
+			if(symmetry.apply(rootSymmetries[r], cell) < cell){
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void clearMoveOrdering()
+	{
+		for(int p=0; p<256; p++){
+			killers[p][0] = -1;
+			killers[p][1] = -1;
+		}
+		for(int p=0; p<3; p++){
+			for(int c=0; c<256; c++){
+				historyScore[p][c] = 0;
+			}
+		}
+	}
+	//Collect the moves to search in the node and score them for ordering, in this order of precedence:
+	//the transposition table move, immediate wins, blocks of the opponent's immediate wins, killer moves,
+	//history score, and finally the number of lines through the cell, which favors center and corners.
+	int generateMoves(int turn, int ply, int ttMove, int* moves, int* scores)
+	{
+		return (this->*generateMovesImpl)(turn, ply, ttMove, moves, scores);
+	}
+	template<int Size, int ToWin>
+	int generateMovesKernel(int turn, int ply, int ttMove, int* moves, int* scores)
+	{
+		const int nCells = Size ? Size*Size*Size : contents.bufferSize();
+		const int toWin = ToWin ? ToWin : nToWin;
+		static const int TTMoveScore = 1 << 30;
+		static const int WinMoveScore = 1 << 29;
+		static const int BlockMoveScore = 1 << 28;
+		static const int KillerMoveScore = 1 << 27;
+		int n = 0;
+		for(int i=0; i<nCells; i++){
+			if(contents[i] == 0 && !(ply == 0 && isSymmetricDuplicate(i))){
+				int score;
+				if(i == ttMove){
+					score = TTMoveScore;
+				}else if(i == killers[ply][0]){
+					score = KillerMoveScore + 1;
+				}else if(i == killers[ply][1]){
+					score = KillerMoveScore;
+				}else{
+					int h = historyScore[turn][i];
+					if(h >= (1 << 16)) h = (1 << 16) - 1;
+					score = (h << 8) + (cellLinesStart[i+1] - cellLinesStart[i]);
 				}
-				contents[i] = 0;//Undo mark
-				if(turn == player){//Player's turn, maximize score
-					if(score > best){
-						best = score;
-						move = i;
-					}
-					if(best >= winScore){
-						break;//Early out, an attempt to cull some branches.
+				moves[n] = i;
+				cellScore[i] = score;
+				++n;
+			}
+		}
+		//Same as the first step of heuristicMove(): the empty cell of a line one mark short of winning
+		//is either a winning move or a must-block.
+		const int opponent = 3-turn;
+		for(int block=0; block<nLines; block+=LineKernels::Block){
+			int threats = LineKernels::findThreats(&lineCount[1][block], &lineCount[2][block], toWin);
+			for(int l=block; threats; l++, threats >>= 1){
+				if(! (threats & 1) || l >= nLines){
+					continue;
+				}
+				int nOpp = lineCount[opponent][l];
+				const int* cells = getLine(l);
+				for(int t=0; t<toWin; t++){
+					if(! contents[cells[t]]){
+						int bonus = nOpp ? BlockMoveScore : WinMoveScore;
+						if(cellScore[cells[t]] < bonus){
+							cellScore[cells[t]] = bonus;
+						}
+						break;
 					}
-				}else{//Opponent's turn, minimize score
-					if(score < best){
-						best = score;
-						move = i;
+				}
+			}
+		}
+		for(int m=0; m<n; m++){
+			scores[m] = cellScore[moves[m]];
+		}
+		return n;
+	}
+	//Selection sort step: bring the highest scoring of the remaining moves to position m.
+	//Nodes are often cut off after a move or two, so sorting all moves in advance would be wasted.
+	void pickNextMove(int* moves, int* scores, int m, int n)
+	{
+		int best = m;
+		for(int k=m+1; k<n; k++){
+			if(scores[k] > scores[best]){
+				best = k;
+			}
+		}
+		int x = moves[m]; moves[m] = moves[best]; moves[best] = x;
+		x = scores[m]; scores[m] = scores[best]; scores[best] = x;
+	}
+	//Remember the move which caused a cutoff, to try it early in sibling nodes and in later iterations.
+	void onCutoff(int turn, int move, int ply, int depth, int score)
+	{
+		historyScore[turn][move] += depth*depth;
+		if(score < WinScore/2 && killers[ply][0] != move){
+			killers[ply][1] = killers[ply][0];
+			killers[ply][0] = move;
+		}
+	}
+
+	//Scores of won games depend on the distance from the root, while the table is shared by all nodes.
+	//So they are stored relative to the node and converted back when probed.
+	int scoreToTT(int score, int ply)
+	{
+		if(score > WinScore/2) return score + ply;
+		if(score < -WinScore/2) return score - ply;
+		return score;
+	}
+	int scoreFromTT(int score, int ply)
+	{
+		if(score > WinScore/2) return score - ply;
+		if(score < -WinScore/2) return score + ply;
+		return score;
+	}
+
+	//Minmax routine in its negamax form with alpha-beta pruning.
+	//Returns the score of the position for the player to move (turn) and the best move found.
+	//Branches that can't affect the result, i.e. scoring outside of the (alpha, beta) window, are cut off.
+	//Positions at the search horizon are scored with evaluate().
+	//Results are cached in the transposition table, if there is one.
+	int minmax(int turn, int depth, int alpha, int beta, int ply, int& move)
+	{
+		move = -1;
+		if((++nodeCounter & 1023) == 0){
+			if(timeLimited && std::chrono::steady_clock::now() >= deadline){
+				stopSearch = true;
+			}
+			if(abortSearch && abortSearch->load(std::memory_order_relaxed)){
+				stopSearch = true;
+			}
+		}
+		if(stopSearch){
+			return 0;
+		}
+		if(depth <= 0){
+			SEARCH_STAT(++stats.evaluations);
+			return evaluate(turn);
+		}
+		int ttMove = (ply == 0) ? rootMove : -1;
+		uint64_t key = hash;
+		int sym = 0;//The stored moves are in the orientation of the canonical form.
+		if(tt){
+			if(nMoves <= SymmetryMaxMoves){
+				key = canonicalHash(sym);
+			}
+			TranspositionTable::Entry e;
+			SEARCH_STAT(++stats.ttProbes);
+			if(tt->probe(key, e) && e.move >= 0 && e.move < contents.bufferSize()){
+				SEARCH_STAT(++stats.ttHits);
+				if(ply > 0){
+					ttMove = symmetry.unapply(sym, e.move);
+				}
+				if(e.depth >= depth && ply > 0){//The root must always return a move.
+					int score = scoreFromTT(e.score, ply);
+					if(e.bound == TranspositionTable::Exact ||
+						(e.bound == TranspositionTable::Lower && score >= beta) ||
+						(e.bound == TranspositionTable::Upper && score <= alpha)){
+						move = ttMove;
+						return score;
 					}
-					if(best <= -winScore){
-						break;//Early out, an attempt to cull some branches.
+				}
+			}
+		}
+		const int alphaOrig = alpha;
+		int best = -WinScore-1;
+		int* moves = &moveStack[moveStackTop];
+		int* scores = &moveScoreStack[moveStackTop];
+		const int n = generateMoves(turn, ply, ttMove, moves, scores);
+		moveStackTop += n;
+		for(int m=0; m<n; m++){
+			pickNextMove(moves, scores, m, n);
+			const int i = moves[m];
+			int score = 0;
+			int state = applyMove(i, turn);
+			if(state == 0){//Non-final state, invoke minmax on it from the opponent's side.
+				int reply = 0;
+				score = -minmax(3-turn, depth-1, -beta, -alpha, ply+1, reply);
+			}else if(state == 3){//Draw
+				score = 0;
+			}else{//The move wins. Prefer faster wins.
+				score = WinScore - ply;
+			}
+			undoMove(i);
+			if(stopSearch){
+				moveStackTop -= n;
+				return 0;
+			}
+			if(score > best){
+				best = score;
+				move = i;
+				if(score > alpha){
+					alpha = score;
+					if(alpha >= beta){
+						SEARCH_STAT(++stats.cutoffs);
+						SEARCH_STAT(if(m == 0) ++stats.firstMoveCutoffs);
+						onCutoff(turn, i, ply, depth, score);
+						break;//The opponent won't allow this position, skip the remaining moves.
 					}
 				}
 			}
 		}
+		moveStackTop -= n;
+		if(tt){
+			int bound = TranspositionTable::Exact;
+			if(best <= alphaOrig){
+				bound = TranspositionTable::Upper;
+			}else if(best >= beta){
+				bound = TranspositionTable::Lower;
+			}
+			tt->store(key, scoreToTT(best, ply), symmetry.apply(sym, move), depth, bound);
+		}
 		return best;
 	}
 
+	//The best move stored in the transposition table for the current position, or -1 if there's none.
+	int probeMove()
+	{
+		if(! tt){
+			return -1;
+		}
+		int sym = 0;
+		uint64_t key = (nMoves <= SymmetryMaxMoves) ? canonicalHash(sym) : hash;
+		TranspositionTable::Entry e;
+		if(tt->probe(key, e) && e.move >= 0 && e.move < contents.bufferSize()){
+			int move = symmetry.unapply(sym, e.move);
+			if(contents[move] == 0){
+				return move;
+			}
+		}
+		return -1;
+	}
+#ifdef SEARCH_STATS
+	//Fill stats.pv by following the best moves stored in the transposition table, starting with the given root move.
+	void collectPrincipalVariation(int player, int move, int maxLength)
+	{
+		stats.pv.clear();
+		while(move >= 0 && (int)stats.pv.size() < maxLength){
+			stats.pv.push_back(move);
+			if(applyMove(move, player) != 0){
+				break;
+			}
+			player = 3-player;
+			move = probeMove();
+		}
+		for(size_t m=0; m<stats.pv.size(); m++){
+			undoMove(history[nMoves-1]);
+		}
+	}
+#endif
+
+	//Look the position up in the table of solved positions.
+	//Returns the best move and its SolutionTable::Result, or -1 if the position isn't there.
+	int solvedMove(int& result)
+	{
+		if(! solutions || ! solutions->matches(size, nToWin) || solutions->emptyHash != emptyHash){
+			return -1;
+		}
+		int sym = 0;
+		int move = -1;
+		if(! solutions->find(canonicalHash(sym), move, result) || move >= contents.bufferSize()){
+			return -1;
+		}
+		move = symmetry.unapply(sym, move);
+		return (contents[move] == 0) ? move : -1;
+	}
+
+	//Lazy SMP helper thread routine: searches the same position as the main thread on its own copy of the game.
+	//It only contributes through the shared transposition table. Starting at different depths makes
+	//the helpers and the main thread diverge and fill the table with different parts of the tree.
+	static void helperSearch(Game* helper, int player, int startDepth, int maxDepth)
+	{
+		helper->stopSearch = false;
+		helper->timeLimited = false;//Stopped by the abort flag only.
+		helper->rootMove = -1;
+		helper->moveStackTop = 0;
+		helper->clearMoveOrdering();
+		helper->findRootSymmetries();
+		const int nEmptyCells = helper->contents.bufferSize() - helper->nMoves;
+		for(int depth=startDepth; depth<=maxDepth && depth<=nEmptyCells; depth++){
+			int move = -1;
+			helper->minmax(player, depth, -WinScore-1, WinScore+1, 0, move);
+			if(helper->stopSearch){
+				break;
+			}
+			helper->rootMove = move;
+		}
+	}
+
 	//Minmax AI decision routine.
-	int minmaxMove(int player)
+	//Iterative deepening: searches 1, 2, 3... moves ahead, each iteration starting with the best move of
+	//the previous one, until the time budget (in microseconds) runs out or the outcome is known.
+	//Returns the best move of the deepest completed iteration.
+	//With a transposition table and searchThreads > 1, helper threads search alongside (Lazy SMP).
+	//Progress is kept in stats and reported to onSearchInfo after every iteration. Only the depth, score and move
+	//are kept unless SEARCH_STATS is defined.
+	//Positions found in the table of solved positions are not searched.
+	int minmaxMove(int player, int budgetMicros, int maxDepth = 256)
 	{
-		int move = 0;
-		minmax(player, player, move, 3);
-		return move;
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		deadline = start + std::chrono::microseconds(budgetMicros);
+		stats.clear();
+		int result = 0;
+		const int solved = solvedMove(result);
+		if(solved >= 0){
+			stats.move = solved;
+			stats.score = (result == SolutionTable::Win) ? WinScore : (result == SolutionTable::Loss) ? -WinScore : 0;
+			SEARCH_STAT(stats.pv.push_back(solved));
+			if(onSearchInfo){
+				onSearchInfo(stats);
+			}
+			return solved;
+		}
+		stopSearch = false;
+		timeLimited = false;//Let the first iteration complete to have some move to return.
+		rootMove = -1;
+		moveStackTop = 0;
+		clearMoveOrdering();
+		if(tt){
+			tt->newSearch();
+		}
+		findRootSymmetries();
+
+		//Start the helper threads, each with its own copy of the game.
+		std::atomic<bool> abortHelpers(false);
+		helperThreads.clear();
+		if(tt){
+			while((int)helpers.size() < searchThreads-1){
+				helpers.push_back(std::unique_ptr<Game>(new Game()));
+			}
+			for(int t=1; t<searchThreads; t++){
+				Game* helper = helpers[t-1].get();
+				helper->copyFrom(*this);
+				helper->tt = tt;
+				helper->abortSearch = &abortHelpers;
+				helperThreads.push_back(std::thread(helperSearch, helper, player, 1 + t%2, maxDepth));
+			}
+		}
+
+		const int nEmptyCells = contents.bufferSize() - nMoves;
+		for(int depth=1; depth<=maxDepth && depth<=nEmptyCells; depth++){
+			int move = -1;
+			SEARCH_STAT(const unsigned iterationStart = nodeCounter);
+			int score = minmax(player, depth, -WinScore-1, WinScore+1, 0, move);
+#ifdef SEARCH_STATS
+			const long long iterationNodes = nodeCounter - iterationStart;
+			stats.nodes += iterationNodes;
+			stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+#endif
+			if(stopSearch){
+				break;
+			}
+			rootMove = move;
+#ifdef SEARCH_STATS
+			stats.branchingFactor = stats.iterationNodes ? (double)iterationNodes / stats.iterationNodes : 0.;
+			stats.iterationNodes = iterationNodes;
+			collectPrincipalVariation(player, move, depth);
+#endif
+			stats.depth = depth;
+			stats.score = score;
+			stats.move = move;
+			if(onSearchInfo){
+				onSearchInfo(stats);
+			}
+			if(score > WinScore/2 || score < -WinScore/2){
+				break;//A forced win or loss is found, deeper search won't change it.
+			}
+			timeLimited = true;
+		}
+		timeLimited = false;
+
+		abortHelpers = true;
+		for(size_t t=0; t<helperThreads.size(); t++){
+			helperThreads[t].join();
+		}
+		helperThreads.clear();
+		return rootMove;
 	}
 };
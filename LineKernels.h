@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stdint.h>
+
+//SSE2 is always there on x64, and enabled by default for 32-bit x86 builds by MSVC 2012 and later.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LINE_KERNELS_SSE2
+#include <emmintrin.h>
+#endif
+
+//Evaluation of the winning lines in blocks of 16, from the per-line mark counts of both players.
+//The counts are bytes, so a block fits into one SSE2 register. The scalar fallback does the same one line at a time.
+//The count arrays shall be padded with zeros to a multiple of the block size.
+struct LineKernels
+{
+	static const int Block = 16;
+
+	//Round the number of lines up to whole blocks.
+	static int paddedSize(int nLines)
+	{
+		return (nLines + Block-1) & ~(Block-1);
+	}
+
+	//Write the weights of 16 lines for the heuristic AI: the number of marks in a line if it can still
+	//become winning, i.e. doesn't have both players' marks, otherwise 0.
+	//Returns a bit mask of the lines which can be won with one more move.
+	static int weighLines(const uint8_t* count1, const uint8_t* count2, int nToWin, uint8_t* weights)
+	{
+#ifdef LINE_KERNELS_SSE2
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i c1 = _mm_loadu_si128((const __m128i*)count1);
+		const __m128i c2 = _mm_loadu_si128((const __m128i*)count2);
+		const __m128i live = _mm_or_si128(_mm_cmpeq_epi8(c1, zero), _mm_cmpeq_epi8(c2, zero));
+		const __m128i sum = _mm_add_epi8(c1, c2);
+		_mm_storeu_si128((__m128i*)weights, _mm_and_si128(sum, live));
+		const __m128i oneShort = _mm_cmpeq_epi8(sum, _mm_set1_epi8((char)(nToWin-1)));
+		return _mm_movemask_epi8(_mm_and_si128(oneShort, live));
+#else
+		int mask = 0;
+		for(int l=0; l<Block; l++){
+			const int live = (count1[l] == 0 || count2[l] == 0);
+			const int sum = count1[l] + count2[l];
+			weights[l] = (uint8_t)(live ? sum : 0);
+			if(live && sum == nToWin-1){
+				mask |= 1 << l;
+			}
+		}
+		return mask;
+#endif
+	}
+
+	//Bit mask of the lines among 16 which can be won with one more move, by either player.
+	static int findThreats(const uint8_t* count1, const uint8_t* count2, int nToWin)
+	{
+#ifdef LINE_KERNELS_SSE2
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i c1 = _mm_loadu_si128((const __m128i*)count1);
+		const __m128i c2 = _mm_loadu_si128((const __m128i*)count2);
+		const __m128i live = _mm_or_si128(_mm_cmpeq_epi8(c1, zero), _mm_cmpeq_epi8(c2, zero));
+		const __m128i oneShort = _mm_cmpeq_epi8(_mm_add_epi8(c1, c2), _mm_set1_epi8((char)(nToWin-1)));
+		return _mm_movemask_epi8(_mm_and_si128(oneShort, live));
+#else
+		int mask = 0;
+		for(int l=0; l<Block; l++){
+			if((count1[l] == 0 || count2[l] == 0) && count1[l] + count2[l] == nToWin-1){
+				mask |= 1 << l;
+			}
+		}
+		return mask;
+#endif
+	}
+};
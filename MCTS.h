@@ -0,0 +1,387 @@
+#pragma once
+
+#include <math.h>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include "Game.h"
+
+//Monte Carlo Tree Search AI (UCT).
+/*
+	Instead of evaluating positions, MCTS plays many fast random games (playouts) and grows a tree of
+	the positions it visits, steering towards the moves that won most often so far:
+
+	1. Selection. Descend from the root, picking the child with the best UCB1 score: its win rate
+	plus an exploration bonus for rarely visited children.
+	2. Expansion. Having reached a leaf visited often enough, add its moves as children.
+	Moves that ignore an immediate win or a must-block are left out.
+	3. Playout. Finish the game from the leaf with random moves, except that immediate wins are
+	taken and the opponent's immediate wins are blocked.
+	4. Backpropagation. Add the result to every node on the path.
+
+	The move picked is the most visited root child.
+
+	Nodes live in a preallocated arena and refer to each other by index. The subtree of the actual
+	position is kept between moves, so the search continues where it left off.
+	Several threads can grow the same tree (tree parallelization). Node statistics are updated with
+	atomics, and a "virtual loss" is added to the nodes a thread is descending through, so that the
+	other threads are pushed to explore other branches meanwhile.
+*/
+struct MCTS
+{
+	struct Node
+	{
+		std::atomic<int> visits;
+		std::atomic<int> score;//Sum of the results for the player who made the move: 2 for a win, 1 for a draw.
+		std::atomic<int> virtualLoss;//Number of threads currently descending through the node.
+		std::atomic<int> expansion;//NotExpanded, Expanding or Expanded.
+		int firstChild;//Children are allocated consecutively.
+		short nChildren;
+		short move;//The move leading to the node, -1 at the initial root.
+		char player;//The player who made the move.
+	};
+	enum Expansion {
+		NotExpanded = 0,
+		Expanding,
+		Expanded,
+	};
+	static const int ExpandVisits = 4;//A leaf is expanded after this many playouts through it.
+
+	Node* nodes;
+	int capacity;
+	std::atomic<int> nNodes;
+	std::atomic<bool> full;//Set once the arena has no room for some node's children. Leaves are then only played out.
+	int root;
+	int size;//Game configuration the tree was built for.
+	int nToWin;
+	std::vector<int> rootHistory;//The moves leading to the root position.
+
+	float exploration;//UCB1 exploration constant.
+	int threads;//Number of threads growing the tree, including the calling one.
+	std::atomic<bool>* abortSearch;//Optional flag set by another thread to stop the search.
+	std::atomic<int> iterations;//Playouts done by the latest search.
+
+	MCTS()
+	{
+		nodes = 0;
+		capacity = 0;
+		nNodes = 0;
+		full = false;
+		root = -1;
+		size = 0;
+		nToWin = 0;
+		exploration = 1.f;
+		threads = 1;
+		abortSearch = 0;
+		iterations = 0;
+	}
+	~MCTS()
+	{
+		delete[] nodes;
+	}
+	//Set the arena size in megabytes.
+	void allocate(int megabytes)
+	{
+		delete[] nodes;
+		capacity = (int)(((size_t)megabytes << 20) / sizeof(Node));
+		nodes = new Node[capacity];
+		clear();
+	}
+	void clear()
+	{
+		nNodes = 0;
+		full = false;
+		root = -1;
+		rootHistory.clear();
+	}
+	int newRoot(int lastPlayer)
+	{
+		int n = nNodes++;
+		initNode(n, -1, lastPlayer);
+		return n;
+	}
+	void initNode(int n, int move, int player)
+	{
+		Node& node = nodes[n];
+		node.visits = 0;
+		node.score = 0;
+		node.virtualLoss = 0;
+		node.expansion = NotExpanded;
+		node.firstChild = 0;
+		node.nChildren = 0;
+		node.move = (short)move;
+		node.player = (char)player;
+	}
+
+	//Make the root match the game position, reusing the subtree of the previous search if the
+	//game continues from its root. Otherwise, or when the arena is running out, start a new tree.
+	void setRoot(Game& game, int player)
+	{
+		bool reuse = (root >= 0 && game.size == size && game.nToWin == nToWin && game.nMoves >= (int)rootHistory.size());
+		for(int m=0; reuse && m<(int)rootHistory.size(); m++){
+			reuse = (game.history[m] == rootHistory[m]);
+		}
+		if(reuse && nNodes > capacity/2){
+			reuse = false;//Subtrees aren't compacted, the whole arena is cleared instead.
+		}
+		for(int m=(int)rootHistory.size(); reuse && m<game.nMoves; m++){
+			int next = -1;
+			Node& r = nodes[root];
+			if(r.expansion == Expanded){
+				for(int c=0; c<r.nChildren; c++){
+					if(nodes[r.firstChild + c].move == game.history[m]){
+						next = r.firstChild + c;
+						break;
+					}
+				}
+			}
+			root = next;
+			reuse = (next >= 0);
+		}
+		if(! reuse){
+			clear();
+			size = game.size;
+			nToWin = game.nToWin;
+			root = newRoot(3-player);
+		}
+		rootHistory.assign(game.history, game.history + game.nMoves);
+	}
+
+	//MCTS AI decision routine. Searches until the time budget (in microseconds) or the number of
+	//playouts runs out, and returns the most visited move.
+	int move(Game& game, int player, int budgetMicros, int maxIterations = 1 << 30)
+	{
+		setRoot(game, player);
+		iterations = 0;
+		std::chrono::steady_clock::time_point deadline =
+			std::chrono::steady_clock::now() + std::chrono::microseconds(budgetMicros);
+		std::vector<std::thread> helpers;
+		for(int t=1; t<threads; t++){
+			helpers.push_back(std::thread(&MCTS::search, this, &game, deadline, maxIterations, t));
+		}
+		search(&game, deadline, maxIterations, 0);
+		for(size_t t=0; t<helpers.size(); t++){
+			helpers[t].join();
+		}
+
+		Node& r = nodes[root];
+		int best = -1;
+		int bestVisits = -1;
+		for(int c=0; c<r.nChildren; c++){
+			Node& child = nodes[r.firstChild + c];
+			if(child.visits > bestVisits){
+				bestVisits = child.visits;
+				best = child.move;
+			}
+		}
+		if(best < 0){
+			best = game.randomMove();//Not even a single playout was done.
+		}
+		return best;
+	}
+
+	//Search thread routine. Works on its own copy of the game.
+	void search(Game* source, std::chrono::steady_clock::time_point deadline, int maxIterations, int threadIndex)
+	{
+		Game game;
+		game.copyFrom(*source);
+		const int rootMoves = game.nMoves;
+		uint64_t random = 0x2545F4914F6CDD1Dull * (threadIndex + 1) ^ (uint64_t)deadline.time_since_epoch().count();
+		std::vector<int> path;
+		for(int n=0; ; n++){
+			if((n & 15) == 0){
+				if(std::chrono::steady_clock::now() >= deadline){
+					break;
+				}
+				if(abortSearch && abortSearch->load(std::memory_order_relaxed)){
+					break;
+				}
+			}
+			if(iterations++ >= maxIterations){
+				break;
+			}
+
+			//Selection and expansion.
+			int node = root;
+			path.clear();
+			path.push_back(node);
+			nodes[node].virtualLoss++;
+			int state = 0;
+			while(true){
+				Node& cur = nodes[node];
+				if(cur.expansion != Expanded){
+					if((cur.visits < ExpandVisits || full.load(std::memory_order_relaxed)) && node != root){
+						break;
+					}
+					if(! expand(node, game)){
+						break;//Expanding by another thread, or the arena is full.
+					}
+				}
+				node = selectChild(node, game);
+				path.push_back(node);
+				nodes[node].virtualLoss++;
+				state = game.applyMove(nodes[node].move, nodes[node].player);
+				if(state != 0){
+					break;
+				}
+			}
+			//Playout.
+			if(state == 0){
+				state = playout(game, 3-nodes[node].player, random);
+			}
+			while(game.nMoves > rootMoves){
+				game.undoMove(game.history[game.nMoves-1]);
+			}
+			//Backpropagation.
+			for(size_t p=0; p<path.size(); p++){
+				Node& n = nodes[path[p]];
+				n.score += (state == n.player) ? 2 : (state == 3) ? 1 : 0;
+				n.visits++;
+				n.virtualLoss--;
+			}
+		}
+	}
+	//Add the node's children. Returns false if the node is being expanded by another thread
+	//or there's no space left in the arena.
+	//If the player to move can win at once, that's the only child. If the opponent could win with
+	//the next move, the only children are the blocking moves. Otherwise every empty cell is a child.
+	bool expand(int node, Game& game)
+	{
+		Node& n = nodes[node];
+		int expected = NotExpanded;
+		if(! n.expansion.compare_exchange_strong(expected, Expanding)){
+			return n.expansion.load(std::memory_order_acquire) == Expanded;
+		}
+		const int turn = 3-n.player;
+		int moves[256];
+		int nChildren = 0;
+		int win = -1;
+		for(int l=0; l<game.nLines && win<0; l++){
+			int nOwn = game.lineCount[turn][l];
+			int nOpp = game.lineCount[3-turn][l];
+			if(nOwn + nOpp == game.nToWin-1 && (nOwn == 0 || nOpp == 0)){
+				const int* cells = game.getLine(l);
+				int t = 0;
+				while(game.contents[cells[t]]){
+					++t;
+				}
+				if(nOpp == 0){
+					win = cells[t];
+				}else{
+					bool known = false;
+					for(int m=0; m<nChildren; m++){
+						known |= (moves[m] == cells[t]);
+					}
+					if(! known){
+						moves[nChildren++] = cells[t];
+					}
+				}
+			}
+		}
+		if(win >= 0){
+			moves[0] = win;
+			nChildren = 1;
+		}else if(nChildren == 0){
+			for(int i=0; i<game.contents.bufferSize(); i++){
+				if(game.contents[i] == 0){
+					moves[nChildren++] = i;
+				}
+			}
+		}
+		//Only take the slots if they all fit, so that nNodes never exceeds the capacity.
+		int first = nNodes.load(std::memory_order_relaxed);
+		do{
+			if(first + nChildren > capacity){
+				full.store(true, std::memory_order_relaxed);
+				n.expansion = NotExpanded;
+				return false;
+			}
+		}while(! nNodes.compare_exchange_weak(first, first + nChildren));
+		for(int m=0; m<nChildren; m++){
+			initNode(first + m, moves[m], turn);
+		}
+		n.firstChild = first;
+		n.nChildren = (short)nChildren;
+		n.expansion.store(Expanded, std::memory_order_release);
+		return true;
+	}
+	//Pick the child with the highest UCB1 score. Virtual losses count as lost playouts.
+	//Unvisited children go first, those with more lines through their cell earlier.
+	int selectChild(int node, Game& game)
+	{
+		Node& n = nodes[node];
+		const float logVisits = logf((float)(n.visits + n.virtualLoss + 1));
+		int best = n.firstChild;
+		float bestValue = -1;
+		for(int c=n.firstChild; c<n.firstChild + n.nChildren; c++){
+			Node& child = nodes[c];
+			int visits = child.visits + child.virtualLoss;
+			float value;
+			if(visits == 0){
+				value = 1e6f + (float)(game.cellLinesStart[child.move+1] - game.cellLinesStart[child.move]);
+			}else{
+				value = child.score / (2.f * visits) + exploration * sqrtf(logVisits / visits);
+			}
+			if(value > bestValue){
+				bestValue = value;
+				best = c;
+			}
+		}
+		return best;
+	}
+	//Play the game to the end from the current position and return the final state.
+	//Immediate wins are taken and the opponent's immediate wins blocked, otherwise moves are random.
+	int playout(Game& game, int turn, uint64_t& random)
+	{
+		int empty[256];
+		int nEmpty = 0;
+		for(int i=0; i<game.contents.bufferSize(); i++){
+			if(game.contents[i] == 0){
+				empty[nEmpty++] = i;
+			}
+		}
+		while(true){
+			int cell = -1;
+			//New threats can only appear on the lines through the latest moves of each player.
+			for(int back=2; back>=1 && cell<0; back--){
+				if(game.nMoves >= back){
+					cell = findThreat(game, game.history[game.nMoves-back]);
+				}
+			}
+			int e;
+			if(cell >= 0){
+				for(e=0; empty[e]!=cell; e++);
+			}else{
+				random ^= random << 13;
+				random ^= random >> 7;
+				random ^= random << 17;
+				e = (int)(random % nEmpty);
+				cell = empty[e];
+			}
+			empty[e] = empty[--nEmpty];
+			int state = game.applyMove(cell, turn);
+			if(state != 0){
+				return state;
+			}
+			turn = 3-turn;
+		}
+	}
+	//Find the empty cell completing a line through the given cell for the player who occupies it.
+	int findThreat(Game& game, int cell)
+	{
+		const int player = game.contents[cell];
+		for(int c=game.cellLinesStart[cell]; c<game.cellLinesStart[cell+1]; c++){
+			const int l = game.cellLines[c];
+			if(game.lineCount[player][l] == game.nToWin-1 && game.lineCount[3-player][l] == 0){
+				const int* cells = game.getLine(l);
+				for(int t=0; t<game.nToWin; t++){
+					if(game.contents[cells[t]] == 0){
+						return cells[t];
+					}
+				}
+			}
+		}
+		return -1;
+	}
+};
@@ -1,13 +1,18 @@
 #include <math.h>
 #include <stdio.h>
+#include <thread>
+#include <atomic>
+#include <chrono>
 #include <Windows.h>
 #include <WindowsX.h>
 #include <gl/GL.h>
 #include "VectorMath.h"
 #include "GUI.h"
 #include "Mesh.h"
+#include "Renderer.h"
 #include "Array3.h"
 #include "Game.h"
+#include "MCTS.h"
 
 static const float Pi = 3.14159265358979323846f;
 
@@ -43,8 +48,20 @@ static const float lPosition[] = {
 	0
 };
 
-//static const int ComputerThinkTime = 20; //Number of frames a computer player takes to "think".
-static const int ComputerThinkTime = 10; //Number of frames a computer player takes to "think".
+//static const int ComputerThinkTime = 300; //Minimum time a computer player takes to "think", in milliseconds.
+static const int ComputerThinkTime = 150; //Minimum time a computer player takes to "think", in milliseconds.
+static const int MinmaxMoveTime = 300000; //Time the Minmax AI may spend searching for a move, in microseconds.
+static const int HashTableSize = 64; //Size of the Minmax AI's transposition table, in megabytes.
+static const int MinmaxThreads = 0; //Number of threads the Minmax AI searches with, 0 for one per CPU core.
+static const int MctsMoveTime = 300000; //Time the MCTS AI may spend searching for a move, in microseconds.
+static const int MctsTreeSize = 64; //Size of the MCTS AI's node arena, in megabytes.
+
+//Frame pacing. Frames are rendered only when something changes on screen, and animations advance with the time elapsed.
+static const int FrameTime = 16; //Time between animation frames if swaps can't be synchronized with the display, in milliseconds.
+static const int MaxFrameStep = 50; //Longest time step of an animation frame, in milliseconds, e.g. after the window has been idle.
+static const float GridAnimTime = .16f; //Time constants of the grid and mark animations, in seconds:
+static const float MarkAnimTime = .025f; //the remaining part of the animation shrinks e times in that time.
+static const float MenuRotationSpeed = 30.f; //Top speed of the view's rotation in the main menu, in degrees per second.
 
 struct View
 {
@@ -81,6 +98,9 @@ struct Application
 	POINT press; //Point in window where the LMB was pressed. Used to distinguish impresize clicks from short drags.
 	POINT cursor; //Point in window where the mouse cursor is currently.
 	Game game;
+	TranspositionTable transpositionTable;//Minmax AI search cache, kept between moves of a session.
+	MCTS mcts;//MCTS AI, its tree is kept between moves of a session.
+	SolutionTable solutions;//Solved positions of the current configuration for the Minmax AI, if the Solver program made them.
 	GUI gui;
 	
 	float gridAnimScale;//Grid "expand" animation when starting the game.
@@ -88,12 +108,34 @@ struct Application
 	int playerTurn; //Index of the player whose turn is currently.
 	int latestMark;//The index of the cell where a mark has just been put by a player. Used to animate the mark inside that cell.
 	float markAnimScale;
-	int thinkTimeout;//Delay to slow things down for computer players.
+	float thinkTimeout;//Delay to slow things down for computer players, in milliseconds.
+	float animTime;//Time spent animating, in seconds.
+	bool vsync;//Buffer swaps wait for the display's refresh.
+
+	//The Minmax and MCTS AIs search on a background thread, so that the window stays responsive meanwhile.
+	//The search works on its own copy of the game, and the result is picked up by process() when ready.
+	std::thread aiThread;
+	Game aiGame;
+	std::atomic<bool> aiAbort;//Set to cancel the search.
+	std::atomic<bool> aiDone;//Set by the search thread when aiMove is ready.
+	int aiMove;
 
 	Array3<int> sortedCells;//An array of grid cell indices, sorted in back-to-front order to render with correct transparency.
+	int sortedCase;//The case of the view direction sortedCells is for, see sortCellsBackToFront().
+	Array3<int> cellOrders[48];//The cell orders of all the cases met so far.
 	int selection[3]; //The cell pointed at by a player's cursor.
 
-	//OpenGL display lists for cube and sphere to speed up rendering.
+	//Instanced rendering of the marks, over the grid built once per size. The instances and the grid's drawing order
+	//are rebuilt only when the grid's contents or the back-to-front order change.
+	Renderer renderer;
+	std::vector<Renderer::Instance> instances;
+	bool instancesDirty;
+	Renderer::Range markInstances[2];//Marks of each player, in back-to-front order.
+	Renderer::Range winInstances[2];//Highlights of the winning combination.
+	int selectionInstance;//The highlight of the cell at cursor, updated when the selection changes.
+	int selectionDrawn;
+
+	//OpenGL display lists for cube and sphere, used instead if the OpenGL version doesn't support instancing.
 	int cubeDisplayList;
 	int sphereDisplayList;
 	
@@ -109,7 +151,16 @@ struct Application
 		latestMark = -1;
 		markAnimScale = 0;
 		set(selection, -1,-1,-1);
+		sortedCase = -1;
 		thinkTimeout = 0;
+		animTime = 0;
+		vsync = false;
+		aiAbort = false;
+		aiDone = false;
+		aiMove = -1;
+		instancesDirty = true;
+		selectionInstance = 0;
+		selectionDrawn = -1;
 		
 		if(! createWindow(800, 600)){
 			return;
@@ -119,10 +170,23 @@ struct Application
 			MessageBox(0, "Failed to initialize OpenGL", "Tic Tac Toe", MB_OK|MB_ICONERROR);
 			return;
 		}
-		createDisplayLists();
+		if(! renderer.init(lPosition, lAmbient, lDiffuse, lSpecular)){
+			createDisplayLists();
+		}
+		vsync = setSwapInterval(1);
 		
+		transpositionTable.allocate(HashTableSize);
+		game.tt = &transpositionTable;
+		game.solutions = &solutions;
+		game.searchThreads = (MinmaxThreads > 0) ? MinmaxThreads : std::thread::hardware_concurrency();
+		mcts.allocate(MctsTreeSize);
+		mcts.threads = game.searchThreads;
+		mcts.abortSearch = &aiAbort;
 		game.reset(3, 3);
 		resetSortedCells();
+		if(renderer.ready){
+			renderer.createGrid(game.size);
+		}
 		view.calcViewDir();
 		sortCellsBackToFront();
 		
@@ -188,8 +252,11 @@ struct Application
 	void loop()
 	{
 		MSG msg;
+		std::chrono::steady_clock::time_point lastFrame = std::chrono::steady_clock::now();
+		bool redraw = true;
 		while(IsWindow(window)){
 			while(PeekMessage(&msg, window, 0, 0, PM_REMOVE)){
+				redraw = true;//Any input may change something on screen, and WM_PAINT asks for it.
 				DispatchMessage(&msg);
 				if(! IsWindow(window)){
 					break;
@@ -204,8 +271,8 @@ struct Application
 						if(dx*dx+dy*dy < 5*5){ //It's a click, not a drag.
 							if(selection[0]>=0){ //Some grid cell is actually selected with the cursor.
 								if(game.contents(selection) == 0){ //Selected cell is empty.
-									putMark(selection[0], selection[1], selection[2], playerTurn);
-									makeTurn();
+									int gameState = putMark(selection[0], selection[1], selection[2], playerTurn);
+									makeTurn(gameState);
 								}
 							}
 						}
@@ -249,14 +316,47 @@ struct Application
 					}
 				}
 			}
-			process();
-			refresh();
-			Sleep(10);
+			std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+			float dt = std::chrono::duration<float>(now - lastFrame).count();
+			lastFrame = now;
+			process(dt);
+			const bool animating = isAnimating();
+			if(redraw || animating){
+				//With vsync, SwapBuffers blocks until the display's refresh, which paces the animation.
+				refresh();
+				redraw = false;
+			}
+			if(! animating){
+				waitForEvents(getIdleTimeout());
+			}else if(! vsync){
+				waitForEvents(FrameTime);
+			}
 		}
+		cancelAI();
+	}
+	//Something on screen changes from frame to frame.
+	bool isAnimating()
+	{
+		return gridAnimScale < 1.f || markAnimScale < 1.f || gui.isFading() || gui.dirty || gui.screen == GUI::MainMenu;
 	}
-	void makeTurn()
+	//How long the loop may wait for input when nothing animates: until a computer player's think timeout runs out.
+	//A background search posts a message when it's done.
+	DWORD getIdleTimeout()
 	{
-		int gameState = game.checkGameState();
+		if(inSession && gui.getPlayerType(playerTurn) != 0 && thinkTimeout > 0){
+			return (DWORD)ceilf(thinkTimeout);
+		}
+		return INFINITE;
+	}
+	//Sleep until there's a message in the queue or the timeout, in milliseconds, runs out.
+	void waitForEvents(DWORD timeout)
+	{
+		MsgWaitForMultipleObjectsEx(0, NULL, timeout, QS_ALLINPUT, MWMO_INPUTAVAILABLE);
+	}
+	//Proceed to the next turn or finish the session, given the game state after the latest move.
+	void makeTurn(int gameState)
+	{
+		instancesDirty = true;//A mark has been put.
 		if(gameState != 0){
 			if(gameState != 3){
 				game.markWinningLines();
@@ -277,28 +377,36 @@ struct Application
 		set(selection, -1,-1,-1); //Invalidate selection
 		thinkTimeout = ComputerThinkTime;
 	}
-	void process()
+	//Execute game logic and animation, given the time since the previous frame in seconds.
+	void process(float dt)
 	{
-		//Execute game logic and animation
-		static int frame = 0;
+		//Animations advance by a limited step, so that they don't skip ahead after the loop has been idle.
+		const float step = (dt < MaxFrameStep / 1000.f) ? dt : MaxFrameStep / 1000.f;
 		if(gui.screen == GUI::MainMenu){
-			view.rotation[1] += .5f * sinf(frame/200.f);
+			view.rotation[1] += MenuRotationSpeed * step * sinf(animTime * .3f);
 			view.calcViewDir();
 			sortCellsBackToFront();
 		}
-		if(gridAnimScale < 1.f){
-			gridAnimScale = (gridAnimScale - 1.f) * .9f + 1.f;
-		}
-		if(markAnimScale < 1.f){
-			markAnimScale = (markAnimScale - 1.f) * .5f + 1.f;
-		}
+		gridAnimScale = animate(gridAnimScale, step, GridAnimTime);
+		markAnimScale = animate(markAnimScale, step, MarkAnimTime);
+		gui.animate(step);
 		if(gui.screen != GUI::Game){
 			inSession = false;
+			cancelAI();
 		}
 		if(gui.screen == GUI::Game){
 			if(! inSession){
 				game.reset(gui.getGridSize(), gui.getToWin());
+				mcts.clear();
+				if(! solutions.matches(game.size, game.nToWin)){
+					char path[64];
+					sprintf_s(path, sizeof(path), "Solution-%d-%d.bin", game.size, game.nToWin);
+					solutions.load(path, game.size, game.nToWin);//Without the file, the Minmax AI just searches.
+				}
 				resetSortedCells();
+				if(renderer.ready){
+					renderer.createGrid(game.size);
+				}
 				view.calcViewDir();
 				sortCellsBackToFront();
 				gridFacetAlpha = .5f / game.size;//Denser grid shall have lower opacity to look consistent.
@@ -309,23 +417,32 @@ struct Application
 				thinkTimeout = ComputerThinkTime;
 			}
 			if(gui.getPlayerType(playerTurn) != 0){//AI player type
-				--thinkTimeout;
-				if(thinkTimeout <= 0){
-					int move = 0;
+				thinkTimeout -= dt * 1000;
+				int move = -1;
+				if(gui.getPlayerType(playerTurn) >= 3){
+					//Minmax or MCTS AI player, searching in background.
+					//The move is made when the search is over, but not before the think timeout.
+					if(! aiThread.joinable()){
+						startAI();
+					}
+					if(aiDone && thinkTimeout <= 0){
+						aiThread.join();
+						move = aiMove;
+					}
+				}else if(thinkTimeout <= 0){
 					if(gui.getPlayerType(playerTurn) == 1){
 						//Random AI player
 						move = game.randomMove();
-					}else if(gui.getPlayerType(playerTurn) == 2){
+					}else{
 						//Heuristic AI player
 						move = game.heuristicMove(playerTurn);
-					}else{
-						//Minmax AI player
-						move = game.minmaxMove(playerTurn);
 					}
+				}
+				if(move >= 0){
 					latestMark = move;
-					game.contents[move] = playerTurn;
+					int gameState = game.applyMove(move, playerTurn);
 					markAnimScale = 0;//Start mark "inflate" animation.
-					makeTurn();
+					makeTurn(gameState);
 				}
 			}
 			gui.setWidgetVisible(GUI::GoPlayer1, playerTurn==1);
@@ -334,7 +451,54 @@ struct Application
 				getCellAtCursor();
 			}
 		}
-		++frame;
+		animTime += step;
+	}
+	//Advance an animated scale towards 1, exponentially. It snaps to 1 when the rest is too small to see.
+	static float animate(float scale, float dt, float timeConstant)
+	{
+		if(scale < 1.f){
+			scale = 1.f - (1.f - scale) * expf(-dt / timeConstant);
+			if(scale > .999f){
+				scale = 1.f;
+			}
+		}
+		return scale;
+	}
+	void startAI()
+	{
+		aiGame.copyFrom(game);
+		aiGame.tt = &transpositionTable;
+		aiGame.solutions = &solutions;
+		aiGame.searchThreads = game.searchThreads;
+		aiGame.abortSearch = &aiAbort;
+		aiGame.onSearchInfo = printSearchInfo;
+		aiAbort = false;
+		aiDone = false;
+		aiThread = std::thread(&Application::searchAI, this, playerTurn, gui.getPlayerType(playerTurn));
+	}
+	void searchAI(int player, int playerType)//Runs on the AI thread.
+	{
+		if(playerType == 3){
+			aiMove = aiGame.minmaxMove(player, MinmaxMoveTime);
+		}else{
+			aiMove = mcts.move(aiGame, player, MctsMoveTime);
+		}
+		aiDone = true;
+		PostMessage(window, WM_NULL, 0, 0);//Wake up the main loop if it waits for input.
+	}
+	//Log the progress of the Minmax AI's search to the console.
+	static void printSearchInfo(const SearchStats& stats)
+	{
+		printf("Minmax: ");
+		stats.print(stdout);
+	}
+	//Stop the background search, if any, and discard its result.
+	void cancelAI()
+	{
+		if(aiThread.joinable()){
+			aiAbort = true;
+			aiThread.join();
+		}
 	}
 	void refresh()//Update the visuals.
 	{
@@ -360,7 +524,11 @@ struct Application
 		//We don't really need depth test because we sort objects manually for proper transparency.
 		glDisable(GL_DEPTH_TEST);
 		if(game.size > 0){
-			drawGame();
+			if(renderer.ready){
+				drawGameInstanced();
+			}else{
+				drawGame();
+			}
 		}
 		glDisable(GL_LIGHTING);
 		glEnable(GL_TEXTURE_2D);
@@ -400,6 +568,95 @@ struct Application
 		glRotatef(view.rotation[0], 1,0,0);
 		glRotatef(view.rotation[1], 0,1,0);
 	}
+	//Build the instances of everything drawn on the grid. The selection highlight gets its slot, filled in when drawing.
+	void updateInstances()
+	{
+		renderer.setGridOrder(sortedCells.buffer, sortedCells.bufferSize());
+		instances.clear();
+		const float scale = 1.f/game.size;
+		for(int p=0; p<2; p++){
+			markInstances[p].first = (int)instances.size();
+			for(int a=0; a<game.contents.bufferSize(); a++){
+				const int index = sortedCells[a];
+				if(game.contents[index] == p+1){
+					instances.push_back(makeInstance(index, scale * ((p == 0) ? .5f : .6f), (p == 0) ? markColor1 : markColor2, true, false));
+				}
+			}
+			markInstances[p].count = (int)instances.size() - markInstances[p].first;
+		}
+		for(int p=0; p<2; p++){
+			winInstances[p].first = (int)instances.size();
+			for(int a=0; a<game.contents.bufferSize(); a++){
+				const int index = sortedCells[a];
+				if(game.contents[index] == p+1 && game.winning[index]){
+					instances.push_back(makeInstance(index, scale * ((p == 0) ? .5f : .6f) * 1.2f, winColorDiffuse, true, true));
+				}
+			}
+			winInstances[p].count = (int)instances.size() - winInstances[p].first;
+		}
+		selectionInstance = (int)instances.size();
+		instances.push_back(makeInstance(0, scale, gridCurCellColor, false, false));
+		renderer.setInstances(instances);
+		selectionDrawn = -1;
+		instancesDirty = false;
+	}
+	//An instance in the given cell. Animated instances are scaled up along with the mark just put.
+	Renderer::Instance makeInstance(int index, float scale, const float color[4], bool animated, bool highlight)
+	{
+		int i, j, k;
+		game.contents.getIndices(index, i, j, k);
+		Renderer::Instance instance;
+		set(instance.place,
+			-1.f+2.f*(i+.5f)/game.size,
+			-1.f+2.f*(j+.5f)/game.size,
+			-1.f+2.f*(k+.5f)/game.size);
+		instance.place[3] = scale;
+		for(int c=0; c<4; c++){
+			instance.color[c] = color[c];
+		}
+		instance.cell = animated ? (float)index : -1.f;
+		instance.highlight = highlight ? 1.f : 0.f;
+		return instance;
+	}
+	void drawGameInstanced()
+	{
+		if(instancesDirty){
+			updateInstances();
+		}
+		int selected = -1;
+		if(selection[0] >= 0){
+			selected = game.contents.index(selection[0], selection[1], selection[2]);
+		}
+		if(selected >= 0 && selected != selectionDrawn){
+			renderer.setInstance(selectionInstance, makeInstance(selected, 1.f/game.size, gridCurCellColor, false, false));
+			selectionDrawn = selected;
+		}
+
+		glEnable(GL_CULL_FACE);
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		renderer.begin(latestMark, markAnimScale);
+		//The marks and the highlights go first, with the depth test, as they are almost opaque.
+		//Then the translucent grid is blended over them. Its parts hidden behind marks are discarded by the depth test,
+		//and with the depth buffer left unchanged, the facets and lines of the grid don't fight each other.
+		glEnable(GL_DEPTH_TEST);
+		for(int p=0; p<2; p++){
+			renderer.draw((p == 0) ? Renderer::Cube : Renderer::Sphere, markInstances[p]);
+		}
+		for(int p=0; p<2; p++){
+			renderer.draw((p == 0) ? Renderer::Cube : Renderer::Sphere, winInstances[p]);
+		}
+		glDepthMask(GL_FALSE);
+		renderer.drawGrid(gridFacetColor);
+		if(selected >= 0){
+			Renderer::Range selectionRange = {selectionInstance, 1};
+			renderer.draw(Renderer::Cube, selectionRange);
+		}
+		glDepthMask(GL_TRUE);
+		glDisable(GL_DEPTH_TEST);
+		renderer.end();
+	}
+	//Draw the game with the fixed function pipeline, cell by cell.
 	void drawGame()
 	{
 		glEnable(GL_CULL_FACE);
@@ -536,80 +793,47 @@ struct Application
 	}
 	//In order to have correct transparency, objects must be sorted in back-to-front order relative to the viewer.
 	//Since all objects in this game are located inside a rectangular grid, it is sufficient to sort grid cells.
+	//Visiting the cells axis by axis, each from the far side to the near one, gives a valid back-to-front order.
+	//It depends only on the signs of the view direction's components and on the order of their magnitudes:
+	//the axis closest to the view direction is the outermost loop. These are 48 cases, their orders are cached.
 	void sortCellsBackToFront()
 	{
-		sortCells(sortedCells.buffer, sortedCells.bufferSize());
-	}
-	//Simple recursive qucksort implementation for grid cells.
-	void sortCells(int* v, int n)
-	{
-		if(n < 2){
-			return;
-		}
-		int P = n/2;//Initialize pivot point.
-		const int pivot = v[P];
-		int L = 0;
-		int R = n-1;
-		while(true){
-			while(L<=R && !isCellFurther(pivot, v[L])){
-				++L;
-			}
-			while(L<=R && !isCellFurther(v[R], pivot)){
-				--R;
-			}
-			if(L < R){
-				//Swap v[L] and v[R]
-				int x = v[L]; v[L] = v[R]; v[R] = x;
-				L++;
-				R--;
-			}
-			if(R < L){
-				break;
+		int axes[3] = {0, 1, 2};//Sorted by the magnitude of the view direction, largest first.
+		for(int a=1; a<3; a++){
+			for(int b=a; b>0 && fabs(view.dir[axes[b]]) > fabs(view.dir[axes[b-1]]); b--){
+				int x = axes[b]; axes[b] = axes[b-1]; axes[b-1] = x;
 			}
 		}
-		//if(R != L-1){
-		//	printf("quickSort: R != L-1\n");
-		//}
-		if(P < L){
-			//Swap v[R] with v[P]
-			int x = v[R]; v[R] = v[P]; v[P] = x;
-			R--;
-		}else{
-			//Swap v[L] with v[P]
-			int x = v[L]; v[L] = v[P]; v[P] = x;
-			L++;
-		}
-		int nL = R + 1;
-		int nR = n - L;
-		//Recurse into smaller partition first, to minimize stack depth.
-		if(nL < nR){
-			if(nL > 1){
-				sortCells(v, nL);
-			}
-			if(nR > 1){
-				sortCells(v+L, nR);
-			}
-		}else{
-			if(nR > 1){
-				sortCells(v+L, nR);
-			}
-			if(nL > 1){
-				sortCells(v, nL);
+		const int signs = (view.dir[0] > 0) | (view.dir[1] > 0) << 1 | (view.dir[2] > 0) << 2;
+		const int viewCase = (axes[0]*2 + (axes[1] > axes[2])) * 8 + signs;
+		if(viewCase == sortedCase){
+			return;
+		}
+		Array3<int>& order = cellOrders[viewCase];
+		if(order.size != game.size){//Not made yet for this grid size.
+			order.allocate(game.size);
+			const int n = game.size;
+			int a = 0;
+			int c[3];
+			for(int u=0; u<n; u++){
+				for(int v=0; v<n; v++){
+					for(int w=0; w<n; w++){
+						c[axes[0]] = u;
+						c[axes[1]] = v;
+						c[axes[2]] = w;
+						for(int d=0; d<3; d++){
+							if(signs & (1 << d)){//Looking towards higher indices, so they are further.
+								c[d] = n-1 - c[d];
+							}
+						}
+						order[a++] = order.index(c[0], c[1], c[2]);
+					}
+				}
 			}
 		}
-	}
-	//Comparison function for sorting grid cells in back-to-front order for correct transparency.
-	//Return true is cell1 is further from the viewer than cell2.
-	bool isCellFurther(int cell1, int cell2)
-	{
-		int x1, y1, z1;
-		int x2, y2, z2;
-		game.contents.getIndices(cell1, x1,y1,z1);
-		game.contents.getIndices(cell2, x2,y2,z2);
-		//Distances are calculated as dot products of view direction by a point representing the cell.
-		float dist1 = x1 * view.dir[0] + y1 * view.dir[1] + z1 * view.dir[2];
-		float dist2 = x2 * view.dir[0] + y2 * view.dir[1] + z2 * view.dir[2];
-		return dist1 > dist2;
+		sortedCells = order;
+		sortedCase = viewCase;
+		instancesDirty = true;
 	}
 	void resetSortedCells()
 	{
@@ -617,6 +841,7 @@ struct Application
 		for(int i=0; i<sortedCells.bufferSize(); i++){
 			sortedCells[i] = i;
 		}
+		sortedCase = -1;
 	}
 	void getRayThroughCursor(float p[3], float v[3])
 	{
@@ -668,11 +893,11 @@ struct Application
 			}
 		}
 	}
-	void putMark(int i, int j, int k, int player)
+	int putMark(int i, int j, int k, int player)
 	{
 		latestMark = game.contents.index(i,j,k);
-		game.contents(i,j,k) = playerTurn;
 		markAnimScale = 0;//Start mark "inflate" animation.
+		return game.applyMove(latestMark, playerTurn);
 	}
 };
 
@@ -0,0 +1,395 @@
+#pragma once
+
+/*
+	Instanced rendering of the game's meshes.
+
+	Every mesh (cube, sphere) is uploaded once into a vertex buffer.
+	Every copy of a mesh on the grid is an instance, which has its position, scale and color in an instance buffer.
+	A range of instances is drawn with a single call, in the order they are stored.
+
+	The grid itself is built once per grid size into a vertex buffer of its own: the facets between the cells,
+	grouped by cell, and the grid lines, each drawn once. The cells' ranges of facets are drawn in back-to-front order
+	with a single call.
+	The vertex shader applies the lighting the same way as the fixed function pipeline does with GL_LIGHT0.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include "GLExtensions.h"
+#include "VectorMath.h"
+#include "Mesh.h"
+
+struct Renderer
+{
+	struct Vertex
+	{
+		float pos[3];
+		float normal[3];
+	};
+	struct Instance
+	{
+		float place[4];//Position of the center and scale.
+		float color[4];//Diffuse color, the ambient color is the same.
+		float cell;//Index of the grid cell, to animate the mark just put. -1 for instances which don't animate.
+		float highlight;//1 for highlights of a winning combination, which have double ambient color.
+	};
+	struct Range//A range of vertices or instances.
+	{
+		int first;
+		int count;
+	};
+	enum Meshes {
+		Cube = 0,
+		Sphere,
+		NMeshes
+	};
+	enum Attributes {
+		Position = 0,
+		Normal,
+		InstancePlace,
+		InstanceColor,
+		InstanceCell,
+		NAttributes
+	};
+
+	bool ready;//Set when the OpenGL version supports everything needed.
+	GLuint program;
+	GLuint meshBuffer;
+	GLuint instanceBuffer;
+	int instanceCapacity;//Size of the instance buffer, in instances.
+	Range meshes[NMeshes];
+	GLint animCellUniform;
+	GLint animScaleUniform;
+
+	GLuint gridBuffer;
+	int gridSize;//Grid size the buffer has been built for.
+	std::vector<Range> gridCellFacets;//The facets of every cell, by cell index.
+	Range gridLines;
+	std::vector<GLint> gridDrawFirst;//The ranges of facets to draw, in back-to-front order.
+	std::vector<GLsizei> gridDrawCount;
+
+	Renderer()
+	{
+		ready = false;
+		program = 0;
+		meshBuffer = 0;
+		instanceBuffer = 0;
+		instanceCapacity = 0;
+		memset(meshes, 0, sizeof(meshes));
+		animCellUniform = -1;
+		animScaleUniform = -1;
+		gridBuffer = 0;
+		gridSize = 0;
+		memset(&gridLines, 0, sizeof(gridLines));
+	}
+	//Create the shader and the buffers, given the light's parameters. Returns false if the OpenGL version is too old.
+	bool init(const float lightPosition[4], const float lightAmbient[4], const float lightDiffuse[4], const float lightSpecular[4])
+	{
+		if(! loadGLExtensions() || ! createProgram()){
+			return false;
+		}
+		glUseProgram(program);
+		//The light is a directional one, fixed relative to the viewer.
+		float lightDir[3] = {lightPosition[0], lightPosition[1], lightPosition[2]};
+		const float length = sqrtf(dotProduct(lightDir, lightDir));
+		for(int i=0; i<3; i++){
+			lightDir[i] /= length;
+		}
+		//OpenGL's default global ambient light adds to the light's own.
+		const float ambient[4] = {lightAmbient[0] + .2f, lightAmbient[1] + .2f, lightAmbient[2] + .2f, 1};
+		glUniform3fv(glGetUniformLocation(program, "lightDir"), 1, lightDir);
+		glUniform4fv(glGetUniformLocation(program, "lightAmbient"), 1, ambient);
+		glUniform4fv(glGetUniformLocation(program, "lightDiffuse"), 1, lightDiffuse);
+		glUniform4fv(glGetUniformLocation(program, "lightSpecular"), 1, lightSpecular);
+		animCellUniform = glGetUniformLocation(program, "animCell");
+		animScaleUniform = glGetUniformLocation(program, "animScale");
+		glUseProgram(0);
+		createMeshes();
+		glGenBuffers(1, &instanceBuffer);
+		glGenBuffers(1, &gridBuffer);
+		ready = true;
+		return true;
+	}
+	bool createProgram()
+	{
+		static const char* vertexSource =
+			"#version 120\n"
+			"attribute vec3 position;\n"
+			"attribute vec3 normal;\n"
+			"attribute vec4 instancePlace;\n"
+			"attribute vec4 instanceColor;\n"
+			"attribute vec2 instanceCell;\n"
+			"uniform float animCell;\n"
+			"uniform float animScale;\n"
+			"uniform vec3 lightDir;\n"
+			"uniform vec4 lightAmbient;\n"
+			"uniform vec4 lightDiffuse;\n"
+			"uniform vec4 lightSpecular;\n"
+			"varying vec4 color;\n"
+			"void main()\n"
+			"{\n"
+			"	float scale = instancePlace.w;\n"
+			"	if(instanceCell.x == animCell){\n"
+			"		scale *= animScale;\n"
+			"	}\n"
+			"	gl_Position = gl_ModelViewProjectionMatrix * vec4(instancePlace.xyz + position * scale, 1.0);\n"
+			"	color.rgb = lightAmbient.rgb * instanceColor.rgb * (1.0 + instanceCell.y);\n"
+			"	color.a = instanceColor.a;\n"
+			"	vec3 n = gl_NormalMatrix * normal;\n"
+			"	float len = length(n);\n"
+			"	if(len > 0.0){\n"
+			"		n /= len;\n"
+			"		float diffuse = dot(n, lightDir);\n"
+			"		if(diffuse > 0.0){\n"
+			"			float specular = pow(max(dot(n, normalize(lightDir + vec3(0.0, 0.0, 1.0))), 0.0), 20.0);\n"
+			"			color.rgb += lightDiffuse.rgb * instanceColor.rgb * diffuse + lightSpecular.rgb * specular;\n"
+			"		}\n"
+			"	}\n"
+			"}\n";
+		static const char* fragmentSource =
+			"#version 120\n"
+			"varying vec4 color;\n"
+			"void main()\n"
+			"{\n"
+			"	gl_FragColor = color;\n"
+			"}\n";
+		GLuint vertexShader = compileShader(GL_VERTEX_SHADER, vertexSource);
+		GLuint fragmentShader = compileShader(GL_FRAGMENT_SHADER, fragmentSource);
+		if(vertexShader && fragmentShader){
+			program = glCreateProgram();
+			glAttachShader(program, vertexShader);
+			glAttachShader(program, fragmentShader);
+			static const char* attributeNames[NAttributes] = {"position", "normal", "instancePlace", "instanceColor", "instanceCell"};
+			for(int a=0; a<NAttributes; a++){
+				glBindAttribLocation(program, a, attributeNames[a]);
+			}
+			glLinkProgram(program);
+			GLint linked = 0;
+			glGetProgramiv(program, GL_LINK_STATUS, &linked);
+			if(! linked){
+				char log[1024] = "";
+				glGetProgramInfoLog(program, sizeof(log), 0, log);
+				printf("Shader program failed to link: %s\n", log);
+				program = 0;
+			}
+		}
+		if(vertexShader){
+			glDeleteShader(vertexShader);
+		}
+		if(fragmentShader){
+			glDeleteShader(fragmentShader);
+		}
+		return (program != 0);
+	}
+	GLuint compileShader(GLenum type, const char* source)
+	{
+		GLuint shader = glCreateShader(type);
+		glShaderSource(shader, 1, &source, 0);
+		glCompileShader(shader);
+		GLint compiled = 0;
+		glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+		if(! compiled){
+			char log[1024] = "";
+			glGetShaderInfoLog(shader, sizeof(log), 0, log);
+			printf("Shader failed to compile: %s\n", log);
+			glDeleteShader(shader);
+			return 0;
+		}
+		return shader;
+	}
+	//Put all the meshes into one vertex buffer.
+	void createMeshes()
+	{
+		std::vector<Vertex> vertices;
+		meshes[Cube].first = (int)vertices.size();
+		for(int f=0; f<6; f++){
+			//Rectangular face is rendered as 2 triangles, 6 vertices total.
+			static const int corners[6] = {0, 1, 2, 2, 3, 0};
+			for(int c=0; c<6; c++){
+				addVertex(vertices, cubeVerts[cubeFacets[f][corners[c]]], cubeFacetNormals[f], 1);
+			}
+		}
+		meshes[Cube].count = (int)vertices.size() - meshes[Cube].first;
+
+		meshes[Sphere].first = (int)vertices.size();
+		for(int t=0; t<nSphereTris; t++){
+			for(int i=0; i<3; i++){
+				//Since vertices lie on a unit radius sphere, their coordinates equal to their normals'.
+				addVertex(vertices, sphereVerts[sphereTris[t][i]], sphereVerts[sphereTris[t][i]], 1);
+			}
+		}
+		meshes[Sphere].count = (int)vertices.size() - meshes[Sphere].first;
+
+		glGenBuffers(1, &meshBuffer);
+		glBindBuffer(GL_ARRAY_BUFFER, meshBuffer);
+		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+	//The normal is scaled by normalSign: -1 to reverse it, 0 for lines which aren't lit by the light.
+	static void addVertex(std::vector<Vertex>& vertices, const float pos[3], const float normal[3], float normalSign)
+	{
+		Vertex v;
+		for(int i=0; i<3; i++){
+			v.pos[i] = pos[i];
+			v.normal[i] = normal[i] * normalSign;
+		}
+		vertices.push_back(v);
+	}
+	//Build the grid of the given size, spanning [-1..1] along every axis. Does nothing if it's already built.
+	void createGrid(int size)
+	{
+		if(size == gridSize){
+			return;
+		}
+		gridSize = size;
+		std::vector<Vertex> vertices;
+		const int nCells = size*size*size;
+		const float cell = 1.f/size;//Half of the cell's edge.
+		gridCellFacets.resize(nCells);
+		for(int index=0; index<nCells; index++){
+			const int i = index % size;
+			const int j = (index / size) % size;
+			const int k = (index / size) / size;
+			const float center[3] = {-1.f+2.f*(i+.5f)/size, -1.f+2.f*(j+.5f)/size, -1.f+2.f*(k+.5f)/size};
+			gridCellFacets[index].first = (int)vertices.size();
+			for(int f=0; f<6; f++){
+				//Skip outer facets of the grid.
+				if(f == 0 && i == 0) continue;
+				if(f == 1 && i == size-1) continue;
+				if(f == 3 && k == 0) continue;
+				if(f == 2 && k == size-1) continue;
+				if(f == 4 && j == 0) continue;
+				if(f == 5 && j == size-1) continue;
+				//Reversed winding and normals, so that the facets are seen from inside of the cell.
+				static const int corners[6] = {2, 1, 0, 0, 3, 2};
+				for(int c=0; c<6; c++){
+					const float* v = cubeVerts[cubeFacets[f][corners[c]]];
+					float pos[3];
+					set(pos, center[0] + v[0]*cell, center[1] + v[1]*cell, center[2] + v[2]*cell);
+					addVertex(vertices, pos, cubeFacetNormals[f], -1);
+				}
+			}
+			gridCellFacets[index].count = (int)vertices.size() - gridCellFacets[index].first;
+		}
+		//Every line of the grid goes from one side to the other, and is shared by all the cells along it.
+		gridLines.first = (int)vertices.size();
+		for(int a=0; a<3; a++){
+			const int b = (a+1)%3;
+			const int c = (a+2)%3;
+			for(int u=0; u<=size; u++){
+				for(int w=0; w<=size; w++){
+					float pos[3];
+					pos[b] = -1.f+2.f*u/size;
+					pos[c] = -1.f+2.f*w/size;
+					pos[a] = -1;
+					addVertex(vertices, pos, cubeFacetNormals[0], 0);
+					pos[a] = 1;
+					addVertex(vertices, pos, cubeFacetNormals[0], 0);
+				}
+			}
+		}
+		gridLines.count = (int)vertices.size() - gridLines.first;
+
+		glBindBuffer(GL_ARRAY_BUFFER, gridBuffer);
+		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		gridDrawFirst.clear();
+		gridDrawCount.clear();
+	}
+	//Set the order in which the cells' facets are drawn.
+	void setGridOrder(const int* cells, int nCells)
+	{
+		gridDrawFirst.clear();
+		gridDrawCount.clear();
+		for(int a=0; a<nCells; a++){
+			const Range& facets = gridCellFacets[cells[a]];
+			if(facets.count > 0){
+				gridDrawFirst.push_back(facets.first);
+				gridDrawCount.push_back(facets.count);
+			}
+		}
+	}
+	//Replace the contents of the instance buffer.
+	void setInstances(const std::vector<Instance>& instances)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+		if((int)instances.size() > instanceCapacity){
+			instanceCapacity = (int)instances.size();
+			glBufferData(GL_ARRAY_BUFFER, instanceCapacity * sizeof(Instance), instances.data(), GL_DYNAMIC_DRAW);
+		}else{
+			glBufferSubData(GL_ARRAY_BUFFER, 0, instances.size() * sizeof(Instance), instances.data());
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+	//Replace a single instance.
+	void setInstance(int index, const Instance& instance)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+		glBufferSubData(GL_ARRAY_BUFFER, index * sizeof(Instance), sizeof(Instance), &instance);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+	//Set up the state for drawing. Instances of the given cell are scaled by animScale.
+	void begin(int animCell, float animScale)
+	{
+		glUseProgram(program);
+		glUniform1f(animCellUniform, (float)animCell);
+		glUniform1f(animScaleUniform, animScale);
+		for(int a=0; a<NAttributes; a++){
+			glVertexAttribDivisor(a, a >= InstancePlace);
+		}
+		glEnableVertexAttribArray(Position);
+		glEnableVertexAttribArray(Normal);
+	}
+	void setVertexBuffer(GLuint buffer)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, buffer);
+		glVertexAttribPointer(Position, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)offsetof(Vertex, pos));
+		glVertexAttribPointer(Normal, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)offsetof(Vertex, normal));
+	}
+	//Draw a range of instances of a mesh.
+	void draw(int mesh, Range instances)
+	{
+		if(instances.count == 0){
+			return;
+		}
+		setVertexBuffer(meshBuffer);
+		//The instance attributes point at the first instance to draw.
+		const size_t offset = instances.first * sizeof(Instance);
+		glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+		glVertexAttribPointer(InstancePlace, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (const void*)(offset + offsetof(Instance, place)));
+		glVertexAttribPointer(InstanceColor, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (const void*)(offset + offsetof(Instance, color)));
+		glVertexAttribPointer(InstanceCell, 2, GL_FLOAT, GL_FALSE, sizeof(Instance), (const void*)(offset + offsetof(Instance, cell)));
+		for(int a=InstancePlace; a<NAttributes; a++){
+			glEnableVertexAttribArray(a);
+		}
+		glDrawArraysInstanced(GL_TRIANGLES, meshes[mesh].first, meshes[mesh].count, instances.count);
+	}
+	//Draw the grid's facets in the order set by setGridOrder(), then its lines, all in one color.
+	void drawGrid(const float color[4])
+	{
+		setVertexBuffer(gridBuffer);
+		//The whole grid is one object, so the instance attributes are constant.
+		for(int a=InstancePlace; a<NAttributes; a++){
+			glDisableVertexAttribArray(a);
+		}
+		glVertexAttrib4f(InstancePlace, 0, 0, 0, 1);
+		glVertexAttrib4fv(InstanceColor, color);
+		glVertexAttrib2f(InstanceCell, -1, 0);
+		if(! gridDrawFirst.empty()){
+			glMultiDrawArrays(GL_TRIANGLES, gridDrawFirst.data(), gridDrawCount.data(), (GLsizei)gridDrawFirst.size());
+		}
+		glDrawArrays(GL_LINES, gridLines.first, gridLines.count);
+	}
+	//Restore the state for the fixed function pipeline.
+	void end()
+	{
+		for(int a=0; a<NAttributes; a++){
+			glVertexAttribDivisor(a, 0);
+			glDisableVertexAttribArray(a);
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		glUseProgram(0);
+	}
+};
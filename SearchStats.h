@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stdio.h>
+#include <vector>
+
+//Counters of the minmax search are only collected when SEARCH_STATS is defined.
+//Otherwise the statements wrapped in SEARCH_STAT() compile to nothing.
+#ifdef SEARCH_STATS
+#define SEARCH_STAT(statement) statement
+#else
+#define SEARCH_STAT(statement)
+#endif
+
+//Progress of Game::minmaxMove(), reported after every completed iteration of iterative deepening.
+struct SearchStats
+{
+	int depth;//Depth of the latest completed iteration.
+	int score;//Its score and best move.
+	int move;
+
+	//Collected with SEARCH_STATS only.
+	std::vector<int> pv;//Principal variation: the expected moves of both players, starting with the best move.
+	double seconds;//Time since the search started.
+	long long nodes;//Nodes searched by all iterations so far, by the calling thread only.
+	long long iterationNodes;//Nodes searched by the latest iteration.
+	double branchingFactor;//Effective branching factor: ratio of the nodes of the latest two iterations.
+	long long evaluations;//Positions scored with evaluate() at the search horizon.
+	long long ttProbes;
+	long long ttHits;//Probes which found the position.
+	long long cutoffs;//Nodes where the search failed high.
+	long long firstMoveCutoffs;//Those failing high on the first move searched. The ratio measures the move ordering.
+
+	SearchStats()
+	{
+		clear();
+	}
+	void clear()
+	{
+		depth = 0;
+		score = 0;
+		move = -1;
+		pv.clear();
+		seconds = 0;
+		nodes = 0;
+		iterationNodes = 0;
+		branchingFactor = 0;
+		evaluations = 0;
+		ttProbes = 0;
+		ttHits = 0;
+		cutoffs = 0;
+		firstMoveCutoffs = 0;
+	}
+	//Print a one-line summary.
+	void print(FILE* f) const
+	{
+		fprintf(f, "depth %d score %d move %d", depth, score, move);
+#ifdef SEARCH_STATS
+		fprintf(f, " nodes %lld (%.0f/s) ebf %.2f time %.3fs", nodes, seconds > 0 ? nodes / seconds : 0., branchingFactor, seconds);
+		fprintf(f, " evals %lld tt hits %.1f%% first move cutoffs %.1f%%", evaluations,
+			ttProbes ? 100. * ttHits / ttProbes : 0., cutoffs ? 100. * firstMoveCutoffs / cutoffs : 0.);
+		fprintf(f, " pv");
+		for(size_t m=0; m<pv.size(); m++){
+			fprintf(f, " %d", pv[m]);
+		}
+#endif
+		fprintf(f, "\n");
+	}
+};
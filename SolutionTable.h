@@ -0,0 +1,180 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+//Solved positions of one grid configuration, written by the Solver program and used by the Minmax AI.
+//Positions are stored by the hash of their canonical form (see Game::canonicalHash()), along with
+//the game-theoretic result for the player to move and the best move, in the canonical orientation.
+//Open addressing hash table, so a lookup takes O(1). It's saved to disk as is.
+struct SolutionTable
+{
+	enum Result {
+		Loss = 0, //The player to move loses against perfect play.
+		Draw = 1,
+		Win = 2,
+	};
+	static const uint32_t Magic = 0x4C4F5333; //"3SOL"
+
+	int size;//Game configuration.
+	int nToWin;
+	uint64_t emptyHash;//Game::emptyHash when the table was made. The hashes are only valid with the same keys.
+	int count;//Number of positions.
+	std::vector<uint64_t> keys;//0 marks an empty slot. The number of slots is a power of 2.
+	std::vector<uint16_t> data;//Move: 8 bits, result: 2 bits.
+
+	SolutionTable()
+	{
+		size = 0;
+		nToWin = 0;
+		emptyHash = 0;
+		count = 0;
+	}
+	//Start an empty table for up to maxCount positions.
+	void create(int sz, int ntw, uint64_t empty, int maxCount)
+	{
+		size = sz;
+		nToWin = ntw;
+		emptyHash = empty;
+		count = 0;
+		size_t nSlots = 16;
+		while(nSlots < (size_t)maxCount * 2){//Keep the load factor under 1/2 so that probe sequences are short.
+			nSlots *= 2;
+		}
+		keys.assign(nSlots, 0);
+		data.assign(nSlots, 0);
+	}
+	//Reduce the number of slots to the minimum for the positions stored, e.g. before saving.
+	void shrink()
+	{
+		std::vector<uint64_t> oldKeys;
+		std::vector<uint16_t> oldData;
+		oldKeys.swap(keys);
+		oldData.swap(data);
+		create(size, nToWin, emptyHash, count);
+		for(size_t slot=0; slot<oldKeys.size(); slot++){
+			if(oldKeys[slot]){
+				insert(oldKeys[slot], oldData[slot] & 255, oldData[slot] >> 8);
+			}
+		}
+	}
+	bool matches(int sz, int ntw) const
+	{
+		return count > 0 && size == sz && nToWin == ntw;
+	}
+	size_t findSlot(uint64_t key) const
+	{
+		const size_t mask = keys.size() - 1;
+		size_t slot = (size_t)key & mask;
+		while(keys[slot] != 0 && keys[slot] != key){
+			slot = (slot + 1) & mask;
+		}
+		return slot;
+	}
+	//Returns false if the table is full.
+	bool insert(uint64_t key, int move, int result)
+	{
+		size_t slot = findSlot(key);
+		if(keys[slot] == 0){
+			if((size_t)(count+1) * 2 > keys.size()){
+				return false;
+			}
+			++count;
+		}
+		keys[slot] = key;
+		data[slot] = (uint16_t)(move | result << 8);
+		return true;
+	}
+	bool find(uint64_t key, int& move, int& result) const
+	{
+		if(keys.empty()){
+			return false;
+		}
+		size_t slot = findSlot(key);
+		if(keys[slot] == 0){
+			return false;
+		}
+		move = data[slot] & 255;
+		result = data[slot] >> 8;
+		return true;
+	}
+	bool contains(uint64_t key) const
+	{
+		return ! keys.empty() && keys[findSlot(key)] != 0;
+	}
+
+	//fopen() is deprecated by MSVC in favor of fopen_s().
+	static FILE* openFile(const char* path, const char* mode)
+	{
+#ifdef _MSC_VER
+		FILE* f = 0;
+		return (fopen_s(&f, path, mode) == 0) ? f : 0;
+#else
+		return fopen(path, mode);
+#endif
+	}
+	//File layout: magic, size, nToWin, count, number of slots (32 bits each), emptyHash, the keys, the data.
+	bool save(const char* path) const
+	{
+		FILE* f = openFile(path, "wb");
+		if(! f){
+			return false;
+		}
+		uint32_t header[5] = {Magic, (uint32_t)size, (uint32_t)nToWin, (uint32_t)count, (uint32_t)keys.size()};
+		bool ok = fwrite(header, sizeof(header), 1, f) == 1 &&
+			fwrite(&emptyHash, sizeof(emptyHash), 1, f) == 1 &&
+			fwrite(keys.data(), sizeof(uint64_t), keys.size(), f) == keys.size() &&
+			fwrite(data.data(), sizeof(uint16_t), data.size(), f) == data.size();
+		return fclose(f) == 0 && ok;
+	}
+	//Load the table of the given grid configuration.
+	//Returns false if the file is missing, isn't a valid table or is made for another configuration.
+	bool load(const char* path, int sz, int ntw)
+	{
+		count = 0;
+		keys.clear();
+		data.clear();
+		FILE* f = openFile(path, "rb");
+		if(! f){
+			return false;
+		}
+		uint32_t header[5];
+		bool ok = fread(header, sizeof(header), 1, f) == 1 && header[0] == Magic &&
+			header[1] == (uint32_t)sz && header[2] == (uint32_t)ntw &&
+			header[4] >= 16 && (header[4] & (header[4]-1)) == 0 && header[3] <= header[4] / 2 &&
+			fread(&emptyHash, sizeof(emptyHash), 1, f) == 1;
+		//Check the number of slots against the file size before allocating them.
+		if(ok){
+			const long dataStart = ftell(f);
+			ok = fseek(f, 0, SEEK_END) == 0 &&
+				(uint64_t)(ftell(f) - dataStart) == (uint64_t)header[4] * (sizeof(uint64_t) + sizeof(uint16_t)) &&
+				fseek(f, dataStart, SEEK_SET) == 0;
+		}
+		if(ok){
+			keys.resize(header[4]);
+			data.resize(header[4]);
+			ok = fread(keys.data(), sizeof(uint64_t), keys.size(), f) == keys.size() &&
+				fread(data.data(), sizeof(uint16_t), data.size(), f) == data.size();
+		}
+		//The positions must match the header's count, which leaves empty slots to end the probe sequences.
+		if(ok){
+			uint32_t nonEmpty = 0;
+			for(size_t slot=0; slot<keys.size(); slot++){
+				nonEmpty += (keys[slot] != 0);
+			}
+			ok = (nonEmpty == header[3]);
+		}
+		fclose(f);
+		if(! ok){
+			keys.clear();
+			data.clear();
+			return false;
+		}
+		size = sz;
+		nToWin = ntw;
+		count = header[3];
+		return true;
+	}
+};
@@ -0,0 +1,296 @@
+//Offline solver: finds the outcome of a grid configuration under perfect play and writes
+//the positions needed to play it perfectly into a SolutionTable file, which the Minmax AI then uses.
+/*
+	Portable, only depends on the game engine headers. Build with:
+		g++ -O2 -std=c++11 -pthread Solver.cpp -o solver
+	or the Solver project in the solution.
+
+	Usage: solver -size N -towin N [options]
+		-time N         Give up after this many seconds (default: 600).
+		-hash N         Transposition table size in megabytes (default: 256).
+		-entries N      Maximum number of positions in the table (default: 1000000).
+		-out FILE       Output file (default: Solution-<size>-<towin>.bin, the name the game looks for).
+
+	The search is alpha-beta over the results win/draw/loss, with a transposition table keyed by
+	the canonical form of the positions, so that symmetric positions are solved once. Forced moves
+	are used to prune the tree: a player having an immediate win takes it, a player facing one threat
+	must block it, and a player facing two threats in different cells has lost.
+
+	The table holds the proof: every position the winner can face along with its winning move,
+	and every position the loser can face, so that the AI plays perfectly on either side.
+	In drawn games this is the whole game tree, which is cut short by the entry limit.
+	Positions which didn't fit are searched by the Minmax AI as usual.
+
+	3x3x3 and 4x4x4 with 3 to win and other configurations with short forced wins are solved in seconds.
+	Larger ones such as Qubic (4x4x4, 4 to win) take far more than this simple search can do in a
+	reasonable time. If the time runs out while the table is being written, the positions stored so far are saved.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include "Game.h"
+
+struct Solver
+{
+	//Positions with up to this many marks are looked up by their canonical hash, see Game::SymmetryMaxMoves.
+	static const int SymmetryMaxMoves = 12;
+
+	Game game;
+	TranspositionTable tt;
+	SolutionTable table;
+	std::chrono::steady_clock::time_point deadline;
+	bool aborted;
+	bool full;//The table reached the entry limit.
+	long long nodes;
+
+	Solver()
+	{
+		aborted = false;
+		full = false;
+		nodes = 0;
+	}
+
+	//The cells which complete a line in a single move. Returns the player's own winning cell if there's one.
+	//Otherwise returns -1 and sets nBlocks to 0, 1 or 2 (for two or more) cells where the opponent wins.
+	int findThreats(int turn, int& block, int& nBlocks)
+	{
+		nBlocks = 0;
+		block = -1;
+		const int nLines = game.nLines;
+		for(int b=0; b<nLines; b+=LineKernels::Block){
+			int threats = LineKernels::findThreats(&game.lineCount[1][b], &game.lineCount[2][b], game.nToWin);
+			for(int l=b; threats; l++, threats >>= 1){
+				if(! (threats & 1) || l >= nLines){
+					continue;
+				}
+				const int* cells = game.getLine(l);
+				int cell = 0;
+				for(int t=0; t<game.nToWin; t++){
+					if(! game.contents[cells[t]]){
+						cell = cells[t];
+						break;
+					}
+				}
+				if(game.lineCount[turn][l]){
+					return cell;
+				}
+				if(nBlocks == 0 || (nBlocks == 1 && cell != block)){
+					++nBlocks;
+					block = cell;
+				}
+			}
+		}
+		return -1;
+	}
+
+	//The result of the position for the player to move: 1 win, 0 draw, -1 loss, and the best move.
+	int solve(int turn, int alpha, int beta, int& bestMove)
+	{
+		bestMove = -1;
+		if((++nodes & 4095) == 0 && std::chrono::steady_clock::now() >= deadline){
+			aborted = true;
+		}
+		if(aborted){
+			return 0;
+		}
+		int block;
+		int nBlocks;
+		int win = findThreats(turn, block, nBlocks);
+		if(win >= 0){
+			bestMove = win;
+			return 1;
+		}
+		if(nBlocks == 2){
+			bestMove = block;
+			return -1;
+		}
+
+		int sym = 0;
+		uint64_t key = (game.nMoves <= SymmetryMaxMoves) ? game.canonicalHash(sym) : game.hash;
+		int ttMove = -1;
+		TranspositionTable::Entry e;
+		if(tt.probe(key, e) && e.move >= 0 && e.move < game.contents.bufferSize() &&
+			game.contents[game.symmetry.unapply(sym, e.move)] == 0){
+			ttMove = game.symmetry.unapply(sym, e.move);
+			if(e.bound == TranspositionTable::Exact ||
+				(e.bound == TranspositionTable::Lower && e.score >= beta) ||
+				(e.bound == TranspositionTable::Upper && e.score <= alpha)){
+				bestMove = ttMove;
+				return e.score;
+			}
+		}
+
+		//Candidate moves: the block only if there's a threat, otherwise every empty cell.
+		//They're tried in order of the number of own threats they make, then the number of lines through the cell.
+		int moves[256];
+		int scores[256];
+		int n = 0;
+		if(nBlocks == 1){
+			moves[n] = block;
+			scores[n++] = 0;
+		}else{
+			const int opponent = 3-turn;
+			for(int i=0; i<game.contents.bufferSize(); i++){
+				if(game.contents[i]){
+					continue;
+				}
+				int score = (i == ttMove) ? (1 << 30) : 0;
+				for(int c=game.cellLinesStart[i]; c<game.cellLinesStart[i+1]; c++){
+					const int l = game.cellLines[c];
+					if(game.lineCount[opponent][l] == 0){
+						score += (game.lineCount[turn][l] == game.nToWin-2) ? 256 : 1;
+					}
+				}
+				moves[n] = i;
+				scores[n++] = score;
+			}
+		}
+
+		const int alphaOrig = alpha;
+		int best = -2;
+		for(int m=0; m<n; m++){
+			game.pickNextMove(moves, scores, m, n);
+			const int i = moves[m];
+			int score;
+			int state = game.applyMove(i, turn);
+			if(state == 3){
+				score = 0;
+			}else if(state != 0){
+				score = 1;
+			}else{
+				int reply;
+				score = -solve(3-turn, -beta, -alpha, reply);
+			}
+			game.undoMove(i);
+			if(aborted){
+				return 0;
+			}
+			if(score > best){
+				best = score;
+				bestMove = i;
+				if(score > alpha){
+					alpha = score;
+					if(alpha >= beta){
+						break;
+					}
+				}
+			}
+		}
+		int bound = TranspositionTable::Exact;
+		if(best <= alphaOrig){
+			bound = TranspositionTable::Upper;
+		}else if(best >= beta){
+			bound = TranspositionTable::Lower;
+		}
+		//Deeper subtrees took longer to solve, so they're kept in the table rather than shallow ones.
+		//The depth is halved to fit into the entry's 7 bits.
+		tt.store(key, best, game.symmetry.apply(sym, bestMove), (game.contents.bufferSize() - game.nMoves) / 2, bound);
+		return best;
+	}
+
+	//Store the position, then the positions either player may face next: after the winning move at won
+	//positions, and after every move otherwise. Returns false when the time or the table runs out.
+	bool extract(int turn)
+	{
+		int sym = 0;
+		const uint64_t key = game.canonicalHash(sym);
+		if(table.contains(key)){
+			return true;//Reached by another move order or a symmetric one.
+		}
+		int move;
+		const int result = solve(turn, -1, 1, move);
+		if(aborted){
+			return false;
+		}
+		if(! table.insert(key, game.symmetry.apply(sym, move), result + 1)){
+			full = true;
+			return false;
+		}
+		for(int i=0; i<game.contents.bufferSize(); i++){
+			if(game.contents[i] || (result == 1 && i != move)){
+				continue;
+			}
+			bool ok = true;
+			if(game.applyMove(i, turn) == 0){
+				ok = extract(3-turn);
+			}
+			game.undoMove(i);
+			if(! ok){
+				return false;
+			}
+		}
+		return true;
+	}
+};
+
+int main(int argc, char** argv)
+{
+	int size = 0;
+	int nToWin = 0;
+	int seconds = 600;
+	int hashSize = 256;
+	int maxEntries = 1000000;
+	const char* path = 0;
+	bool ok = true;
+	for(int a=1; a+1<argc && ok; a+=2){
+		const char* value = argv[a+1];
+		if(! strcmp(argv[a], "-size")){
+			size = atoi(value);
+		}else if(! strcmp(argv[a], "-towin")){
+			nToWin = atoi(value);
+		}else if(! strcmp(argv[a], "-time")){
+			seconds = atoi(value);
+		}else if(! strcmp(argv[a], "-hash")){
+			hashSize = atoi(value);
+		}else if(! strcmp(argv[a], "-entries")){
+			maxEntries = atoi(value);
+		}else if(! strcmp(argv[a], "-out")){
+			path = value;
+		}else{
+			ok = false;
+		}
+	}
+	if(! ok || argc % 2 == 0 || size < 3 || size > 6 || nToWin < 3 || nToWin > size || seconds <= 0 || hashSize <= 0 || maxEntries <= 0){
+		fprintf(stderr, "Usage: %s -size N -towin N [-time seconds] [-hash MB] [-entries N] [-out FILE]\n", argv[0]);
+		return 1;
+	}
+	char defaultPath[64];
+	if(! path){
+#ifdef _MSC_VER
+		sprintf_s(defaultPath, sizeof(defaultPath), "Solution-%d-%d.bin", size, nToWin);
+#else
+		snprintf(defaultPath, sizeof(defaultPath), "Solution-%d-%d.bin", size, nToWin);
+#endif
+		path = defaultPath;
+	}
+
+	Solver* solver = new Solver();//Too large for the stack.
+	solver->tt.allocate(hashSize);
+	solver->game.reset(size, nToWin);
+	solver->table.create(size, nToWin, solver->game.emptyHash, maxEntries);
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	solver->deadline = start + std::chrono::seconds(seconds);
+
+	int move;
+	const int result = solver->solve(1, -1, 1, move);
+	if(solver->aborted){
+		printf("Not solved in %d s, %lld nodes.\n", seconds, solver->nodes);
+		return 1;
+	}
+	static const char* resultNames[3] = {"Player 2 wins", "draw", "Player 1 wins"};
+	printf("%dx%dx%d, %d to win: %s, first move %d. %lld nodes, %.1f s.\n", size, size, size, nToWin,
+		resultNames[result + 1], move, solver->nodes,
+		std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+
+	bool complete = solver->extract(1);
+	printf("%d positions%s.\n", solver->table.count,
+		complete ? "" : solver->full ? ", incomplete: entry limit reached" : ", incomplete: out of time");
+	solver->table.shrink();
+	if(! solver->table.save(path)){
+		fprintf(stderr, "Failed to write %s\n", path);
+		return 1;
+	}
+	printf("Saved to %s\n", path);
+	return 0;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <vector>
+
+//The 48 symmetries of the cubic grid: 6 permutations of the axes times 8 combinations of mirroring them.
+//They map winning lines to winning lines, so positions transformed by any of them are equivalent.
+//Each symmetry is precomputed as a permutation of cell indices for the given grid size.
+struct Symmetry
+{
+	static const int NSymmetries = 48;
+	int size;
+	int nCells;
+	std::vector<int> forward;//forward[s*nCells + c] is where symmetry s moves cell c.
+	std::vector<int> backward;//The inverse permutations.
+
+	Symmetry()
+	{
+		size = 0;
+		nCells = 0;
+	}
+	void build(int sz)
+	{
+		static const int axisOrders[6][3] = {
+			{0,1,2}, {0,2,1}, {1,0,2}, {1,2,0}, {2,0,1}, {2,1,0},
+		};
+		size = sz;
+		nCells = size*size*size;
+		forward.resize(NSymmetries*nCells);
+		backward.resize(NSymmetries*nCells);
+		//Symmetry 0 is the identity.
+		for(int s=0; s<NSymmetries; s++){
+			const int* order = axisOrders[s / 8];
+			const int mirror = s % 8;
+			for(int c=0; c<nCells; c++){
+				int v[3] = {c % size, (c / size) % size, c / size / size};
+				int w[3];
+				for(int a=0; a<3; a++){
+					w[a] = v[order[a]];
+					if(mirror & (1 << a)){
+						w[a] = size-1 - w[a];
+					}
+				}
+				int image = w[0] + w[1]*size + w[2]*size*size;
+				forward[s*nCells + c] = image;
+				backward[s*nCells + image] = c;
+			}
+		}
+	}
+	//Where symmetry s moves the cell.
+	int apply(int s, int cell)
+	{
+		return forward[s*nCells + cell];
+	}
+	//Which cell symmetry s moves to the given one.
+	int unapply(int s, int cell)
+	{
+		return backward[s*nCells + cell];
+	}
+};
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <atomic>
+
+//Cache of search results, indexed by the position's Zobrist hash.
+//Lets the search reuse results for positions reached through different move orders (transpositions)
+//and remembers the best move found for every position, which is worth trying first next time.
+struct TranspositionTable
+{
+	enum Bound {
+		Exact = 0, //The score is exact.
+		Lower = 1, //The search failed high, the score is a lower bound.
+		Upper = 2, //The search failed low, the score is an upper bound.
+	};
+	struct Entry //Search result for one position.
+	{
+		int score;
+		int move;
+		int depth;
+		int bound;
+		int age; //Generation of the search which stored the entry.
+	};
+	//The entry as stored in the table: 64 bits of data plus the position hash XORed with the data.
+	//The table is shared by search threads without locking. Each half is read and written atomically (relaxed,
+	//it doesn't order anything else), but if two threads write the same slot at once the halves may still
+	//get mixed up. Then the XOR check fails and the slot reads as a miss.
+	struct Slot
+	{
+		std::atomic<uint64_t> check; //key ^ data
+		std::atomic<uint64_t> data; //score: 32 bits, move: 16 bits, depth: 8 bits (at most 127), bound: 2 bits, age: 6 bits.
+	};
+	static void decode(uint64_t data, Entry& e)
+	{
+		e.score = (int32_t)(uint32_t)data;
+		e.move = (int16_t)(uint16_t)(data >> 32);
+		e.depth = (int8_t)(uint8_t)(data >> 48);
+		e.bound = (int)(data >> 56) & 3;
+		e.age = (int)(data >> 58);
+	}
+	static const int BucketSize = 4;
+	struct Bucket //Slots are grouped so that each bucket occupies exactly one 64 byte cache line.
+	{
+		Slot slots[BucketSize];
+	};
+
+	void* memory; //Allocated block, the buckets start at the first cache line boundary in it.
+	Bucket* buckets;
+	uint64_t nBuckets; //Power of 2, so that the bucket index is the lower bits of the hash.
+	int generation; //Incremented for every new search, so that stale entries are replaced first.
+
+	TranspositionTable()
+	{
+		memory = 0;
+		buckets = 0;
+		nBuckets = 0;
+		generation = 0;
+	}
+	~TranspositionTable()
+	{
+		free(memory);
+	}
+	//Set the table size in megabytes, rounded down to a power of 2, and clear it.
+	void allocate(int megabytes)
+	{
+		uint64_t n = 1;
+		while(n * 2 * sizeof(Bucket) <= (uint64_t)megabytes << 20){
+			n *= 2;
+		}
+		if(n != nBuckets){
+			free(memory);
+			memory = malloc((size_t)(n * sizeof(Bucket)) + 63);
+			buckets = (Bucket*)(((uintptr_t)memory + 63) & ~(uintptr_t)63);
+			nBuckets = n;
+		}
+		clear();
+	}
+	void clear()
+	{
+		for(uint64_t i=0; i<nBuckets; i++){
+			for(int j=0; j<BucketSize; j++){
+				buckets[i].slots[j].check.store(0, std::memory_order_relaxed);
+				buckets[i].slots[j].data.store(0, std::memory_order_relaxed);
+			}
+		}
+		generation = 0;
+	}
+	//Called at the start of every search.
+	void newSearch()
+	{
+		generation = (generation + 1) & 63;
+	}
+	//Look up the position. Returns false if it's not in the table.
+	bool probe(uint64_t key, Entry& e)
+	{
+		Bucket& b = buckets[key & (nBuckets-1)];
+		for(int i=0; i<BucketSize; i++){
+			//Read the slot once, it may be changed by another thread meanwhile.
+			uint64_t data = b.slots[i].data.load(std::memory_order_relaxed);
+			uint64_t check = b.slots[i].check.load(std::memory_order_relaxed);
+			if((check ^ data) == key){
+				decode(data, e);
+				return true;
+			}
+		}
+		return false;
+	}
+	void store(uint64_t key, int score, int move, int depth, int bound)
+	{
+		Bucket& b = buckets[key & (nBuckets-1)];
+		//Overwrite the same position if it's there.
+		//Otherwise evict the entry left by an older search, or the shallowest one.
+		Slot* slot = &b.slots[0];
+		int slotValue = INT32_MAX;
+		for(int i=0; i<BucketSize; i++){
+			uint64_t data = b.slots[i].data.load(std::memory_order_relaxed);
+			uint64_t check = b.slots[i].check.load(std::memory_order_relaxed);
+			if((check ^ data) == key){
+				slot = &b.slots[i];
+				break;
+			}
+			Entry e;
+			decode(data, e);
+			int value = e.depth - (((generation - e.age) & 63) << 8);
+			if(value < slotValue){
+				slot = &b.slots[i];
+				slotValue = value;
+			}
+		}
+		//The depth is stored in 8 signed bits. Up to 216 empty cells could be searched, so deeper results are
+		//stored as 127: the entry then understates its depth, which only makes it easier to replace or re-search.
+		if(depth > 127){
+			depth = 127;
+		}
+		uint64_t data =
+			(uint64_t)(uint32_t)score |
+			(uint64_t)(uint16_t)move << 32 |
+			(uint64_t)(uint8_t)depth << 48 |
+			(uint64_t)(bound | (generation << 2)) << 56;
+		slot->check.store(key ^ data, std::memory_order_relaxed);
+		slot->data.store(data, std::memory_order_relaxed);
+	}
+};